@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+   Read-only view of a contiguous array (pointer + length), e.g. into a std::vector or a memory-mapped file.
+
+   The view does not own the data, i.e. the owner must outlive it.
+*/
+template <typename T>
+class ArrayView
+{
+public:
+    ArrayView() = default;
+    ArrayView(const T* data, const size_t size) : ptr(data), length(size) {}
+
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + length; }
+    const T* data() const { return ptr; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const T& operator[](const size_t i) const { return ptr[i]; }
+
+private:
+    const T* ptr = nullptr;
+    size_t length = 0;
+};
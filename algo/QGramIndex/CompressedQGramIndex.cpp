@@ -0,0 +1,132 @@
+#include "CompressedQGramIndex.hpp"
+#include "Minimizer.hpp"
+#include "qg_util.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+CompressedQGramIndex::CompressedQGramIndex(const std::string& text, const uint8_t q, const QGramOptions& options)
+    : CompressedQGramIndex(text, std::vector<uint32_t>{}, q, options) {
+}
+
+CompressedQGramIndex::CompressedQGramIndex(const std::string& text, const std::vector<uint32_t>& record_starts,
+                                           const uint8_t q, const QGramOptions& options)
+    : text_string(&text), sparse(options.sparse), window(options.window), canonical(options.canonical), rolling(q) {
+    if (!options.seed_mask.empty()) throw std::invalid_argument("Spaced seeds are not supported!");
+    QGramIndex index(text, record_starts, q, options);
+    const std::vector<uint32_t>& sa = index.sa_storage;
+    universe = std::max<uint64_t>(1, canonical ? 2 * uint64_t(text.size()) : text.size());
+
+    // take over the directory; the dense one gets an end sentinel like the sparse one
+    dir.swap(index.dir_storage);
+    if (!sparse) dir.push_back(sa.size());
+    keys.swap(index.key_storage);
+    radix.swap(index.radix_storage);
+    lookup_shift = index.lookup_shift;
+    records.swap(index.record_storage);
+
+    // bit offset of every SAMPLE-th bucket
+    const size_t buckets = dir.size() - 1;
+    offsets.resize(buckets / SAMPLE + 1);
+    uint64_t total = 0;
+    for (size_t b = 0; b < buckets; b++) {
+        if (b % SAMPLE == 0) offsets[b / SAMPLE] = total;
+        total += bucketBits(dir[b + 1] - dir[b]);
+    }
+    code.assign(total / 64 + 2, 0); // padding: readBits() may touch the word after the last one
+
+    // encode every bucket; its entries are in decreasing order of position in the suffix array
+    const auto setBits = [this](const uint64_t pos, const uint64_t value, const unsigned width) {
+        const uint64_t word = pos / 64;
+        const unsigned shift = pos % 64;
+        code[word] |= value << shift;
+        if (shift + width > 64) code[word + 1] |= value >> (64 - shift);
+    };
+    uint64_t offset = 0;
+    for (size_t b = 0; b < buckets; b++) {
+        const uint32_t count = dir[b + 1] - dir[b];
+        const unsigned l = lowBits(count);
+        const uint64_t high_start = offset + uint64_t(count) * l;
+        for (uint32_t i = 0; i < count; i++) {
+            const uint32_t entry = sa[dir[b + 1] - 1 - i];
+            const uint64_t value = canonical ? (uint64_t(QGramIndex::hitPosition(entry)) << 1) | QGramIndex::isReverse(entry)
+                                             : entry;
+            if (l) setBits(offset + uint64_t(i) * l, value & ((uint64_t(1) << l) - 1), l);
+            const uint64_t one = high_start + (value >> l) + i;
+            code[one / 64] |= uint64_t(1) << (one % 64);
+        }
+        offset += bucketBits(count);
+    }
+}
+
+size_t CompressedQGramIndex::bucketOf(uint64_t h) const {
+    if (h > rolling.maxHash()) throw std::invalid_argument("Invalid hash!");
+    if (canonical) h = std::min(h, rolling.reverseComplement(h));
+    if (!sparse) return h;
+    const size_t b = lookup_shift >= 64 ? 0 : h >> lookup_shift;
+    const auto first = keys.begin() + radix[b];
+    const auto last = keys.begin() + radix[b + 1];
+    const auto it = std::lower_bound(first, last, h);
+    if (it == last || *it != h) return NO_BUCKET;
+    return it - keys.begin();
+}
+
+uint32_t CompressedQGramIndex::countHits(const uint64_t h) const {
+    const size_t b = bucketOf(h);
+    return (b == NO_BUCKET) ? 0 : dir[b + 1] - dir[b];
+}
+
+std::vector<uint32_t> CompressedQGramIndex::getHits(const uint32_t h) const {
+    return getHits64(h);
+}
+
+std::vector<uint32_t> CompressedQGramIndex::getHits64(const uint64_t h) const {
+    // decoded in increasing order, stored in decreasing order like QGramIndex::getHits()
+    std::vector<uint32_t> hits(countHits(h));
+    size_t i = hits.size();
+    forEachHit(h, [&hits, &i](const uint32_t hit) { hits[--i] = hit; });
+    return hits;
+}
+
+bool CompressedQGramIndex::occursAt(const std::string& pattern, const size_t pos) const {
+    const size_t m = pattern.size();
+    // case-insensitive, N never matches: as QGramIndex::find()
+    if (pos + m > text_string->size() || !sameBases(text_string->data() + pos, pattern.data(), m)) return false;
+    const size_t r = std::upper_bound(records.begin(), records.end(), pos) - records.begin() - 1;
+    const size_t record_end = (r + 1 < records.size()) ? records[r + 1] : text_string->size();
+    return pos + m <= record_end;
+}
+
+std::vector<uint32_t> CompressedQGramIndex::find(const std::string& pattern) const {
+    const size_t q = getQ();
+    const uint32_t w = std::max<uint32_t>(window, 1);
+    if (pattern.size() < q + w - 1) throw std::invalid_argument("Pattern is shorter than q + w - 1!");
+
+    // seed: the q-gram (minimizer) of the pattern with the fewest hits
+    uint32_t seed = 0, seed_count = ~uint32_t(0);
+    uint64_t seed_hash = 0;
+    bool seed_reverse = false;
+    forEachMinimizer(pattern.data(), pattern.size(), rolling, w, canonical, 0, pattern.size(),
+                     [&](const size_t offset, const uint64_t h, const bool reverse) {
+                         const uint32_t count = countHits(h);
+                         if (count < seed_count) {
+                             seed = offset;
+                             seed_count = count;
+                             seed_hash = h;
+                             seed_reverse = reverse;
+                         }
+                     });
+    // canonical: only hits on the seed's strand are candidates (both for a palindromic seed)
+    const bool palindrome = canonical && seed_hash == rolling.reverseComplement(seed_hash);
+    std::vector<uint32_t> hits;
+    forEachHit(seed_hash, [&](const uint32_t hit) {
+        const uint32_t pos = QGramIndex::hitPosition(hit);
+        if (canonical && !palindrome && QGramIndex::isReverse(hit) != seed_reverse) return;
+        if (pos >= seed && occursAt(pattern, pos - seed)) hits.push_back(pos - seed);
+    });
+    return hits; // decoded in increasing order
+}
+
+size_t CompressedQGramIndex::sizeInBytes() const {
+    return dir.size() * sizeof(uint32_t) + keys.size() * sizeof(uint64_t) + radix.size() * sizeof(uint32_t)
+         + records.size() * sizeof(uint32_t) + offsets.size() * sizeof(uint64_t) + code.size() * sizeof(uint64_t);
+}
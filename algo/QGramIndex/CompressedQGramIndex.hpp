@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "QGramIndex.hpp"
+
+/**
+   A QGramIndex whose buckets are compressed: the positions of every q-gram are sorted and Elias-Fano coded,
+   i.e. a bucket of c positions in a text of length n takes about c * (2 + log2(n/c)) bits instead of c * 32.
+   The saving therefore depends on how full the buckets are: about 2x for a dense index with q = 8 on a
+   100 Mbp genome, down to almost nothing for sparse buckets (large q, minimizers).
+
+   The index is built as a QGramIndex (same options, same peak memory), whose suffix array is then encoded
+   bucket by bucket and released. Hits are decoded on the fly while streaming a bucket (see forEachHit()).
+   The directory (dense or sparse) is the same as in QGramIndex, plus the bit offset of every 8th bucket.
+
+   The text is referenced like in QGramIndex, i.e. it must outlive the index.
+*/
+class CompressedQGramIndex
+{
+public:
+    /**
+     @brief Constructor: build up a compressed q-gram index from @p text (see QGramIndex).
+     @throws std::invalid_argument as QGramIndex
+    */
+    CompressedQGramIndex(const std::string& text, const uint8_t q, const QGramOptions& options = QGramOptions());
+
+    /**
+     @brief Constructor: build up a compressed q-gram index over several records concatenated into @p text (see QGramIndex).
+     @throws std::invalid_argument as QGramIndex, or if options.seed_mask is set (spaced seeds are not supported)
+    */
+    CompressedQGramIndex(const std::string& text, const std::vector<uint32_t>& record_starts, const uint8_t q,
+                         const QGramOptions& options = QGramOptions());
+
+    /**
+      @brief Same as QGramIndex::getHits(): the hits of the q-gram with hash @p h, in the same order.
+      @throws std::invalid_argument("Invalid hash!"); if h is outside of valid hash values
+    */
+    std::vector<uint32_t> getHits(const uint32_t h) const;
+
+    /**
+      @brief Same as QGramIndex::getHits64().
+      @throws std::invalid_argument("Invalid hash!"); if h is outside of valid hash values
+    */
+    std::vector<uint32_t> getHits64(const uint64_t h) const;
+
+    /**
+      @brief Call visit(hit) for every hit of the q-gram with hash @p h, in increasing order of position,
+      decoding the bucket as it goes (no allocation).
+
+      @throws std::invalid_argument("Invalid hash!"); if h is outside of valid hash values
+    */
+    template <typename Visit>
+    void forEachHit(const uint64_t h, Visit&& visit) const {
+        const size_t b = bucketOf(h);
+        if (b == NO_BUCKET) return;
+        decode(bitOffset(b), dir[b + 1] - dir[b], visit);
+    }
+
+    /**
+      @brief Number of hits of the q-gram with hash @p h (no decoding).
+      @throws std::invalid_argument("Invalid hash!"); if h is outside of valid hash values
+    */
+    uint32_t countHits(const uint64_t h) const;
+
+    /**
+      @brief All occurrences of @p pattern in the text, in increasing order (forward strand only).
+
+      Seed and verify as QGramIndex::find(): the rarest q-gram (or minimizer) of the pattern gives the candidates.
+      @throws std::invalid_argument if @p pattern is shorter than q (minimizer index: q + w - 1)
+    */
+    std::vector<uint32_t> find(const std::string& pattern) const;
+
+    /**
+      @brief Memory of the index in bytes (directory and encoded buckets; without the text).
+    */
+    size_t sizeInBytes() const;
+
+    /**
+      @brief Number of positions stored in the index (i.e. the length of the uncompressed suffix array).
+    */
+    size_t size() const { return dir.back(); }
+
+    const std::string& getText() const { return *text_string; }
+
+    uint8_t getQ() const { return rolling.getQ(); }
+
+    bool isSparse() const { return sparse; }
+
+    bool isCanonical() const { return canonical; }
+
+    uint32_t getWindow() const { return window; }
+
+private:
+    static constexpr size_t NO_BUCKET = ~size_t(0);
+    /// Bit offsets are stored for every SAMPLE-th bucket only; the ones in between are computed from the bucket sizes
+    static constexpr size_t SAMPLE = 8;
+
+    /// Bucket of hash @p h, or NO_BUCKET (sparse index, h does not occur)
+    size_t bucketOf(uint64_t h) const;
+    /// Number of low bits per entry of a bucket with @p count entries
+    unsigned lowBits(const uint64_t count) const {
+        if (count == 0 || count >= universe) return 0;
+        return 63 - __builtin_clzll(universe / count);
+    }
+    /// Size of the Elias-Fano code of a bucket with @p count entries: count low parts, then the high parts in unary
+    uint64_t bucketBits(const uint64_t count) const {
+        if (count == 0) return 0;
+        const unsigned l = lowBits(count);
+        return count * l + count + ((universe - 1) >> l) + 1;
+    }
+    /// Bit offset of bucket @p b in the code
+    uint64_t bitOffset(const size_t b) const {
+        uint64_t offset = offsets[b / SAMPLE];
+        for (size_t j = b - b % SAMPLE; j < b; j++) offset += bucketBits(dir[j + 1] - dir[j]);
+        return offset;
+    }
+    /// @p width bits (<= 57) at bit @p pos of the code
+    uint64_t readBits(const uint64_t pos, const unsigned width) const {
+        const uint64_t word = pos / 64;
+        const unsigned shift = pos % 64;
+        uint64_t value = code[word] >> shift;
+        if (shift + width > 64) value |= code[word + 1] << (64 - shift);
+        return value & ((uint64_t(1) << width) - 1);
+    }
+    /// Visit the @p count entries of the bucket starting at bit @p offset, as hits (position, plus STRAND_BIT)
+    template <typename Visit>
+    void decode(const uint64_t offset, const uint32_t count, Visit&& visit) const {
+        if (count == 0) return;
+        const unsigned l = lowBits(count);
+        const uint64_t high_start = offset + uint64_t(count) * l;
+        uint64_t word = high_start / 64;
+        uint64_t bits = code[word] & (~uint64_t(0) << (high_start % 64));
+        for (uint32_t i = 0; i < count; i++) {
+            // the i-th set bit of the high part is at (value >> l) + i
+            while (bits == 0) bits = code[++word];
+            const uint64_t high = word * 64 + __builtin_ctzll(bits) - high_start - i;
+            bits &= bits - 1;
+            const uint64_t value = (high << l) | (l ? readBits(offset + uint64_t(i) * l, l) : 0);
+            visit(canonical ? uint32_t(value >> 1) | (value & 1 ? QGramIndex::STRAND_BIT : 0) : uint32_t(value));
+        }
+    }
+    /// Whether @p pattern occurs at @p pos (within one record)
+    bool occursAt(const std::string& pattern, const size_t pos) const;
+
+    const std::string* text_string;
+    const bool sparse;
+    const uint32_t window;
+    const bool canonical;
+    const RollingHash rolling;
+    uint64_t universe = 1;          ///< entries are < universe: text length (canonical: 2 * text length, strand in bit 0)
+    std::vector<uint32_t> dir;      ///< start of every bucket in the (virtual) suffix array, plus end sentinel
+    std::vector<uint64_t> keys;     ///< sparse: sorted distinct q-gram hashes
+    std::vector<uint32_t> radix;    ///< sparse: radix[b] = first key whose leading bits are b
+    uint32_t lookup_shift = 64;     ///< sparse: 2q - number of leading bits used for the radix table
+    std::vector<uint32_t> records;  ///< start of every record in the text
+    std::vector<uint64_t> offsets;  ///< bit offset of every SAMPLE-th bucket in code
+    std::vector<uint64_t> code;     ///< Elias-Fano code of all buckets (plus one padding word)
+};
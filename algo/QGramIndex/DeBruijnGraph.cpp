@@ -0,0 +1,279 @@
+#include "DeBruijnGraph.hpp"
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// Whether @p c is a base (ACGT, either case)
+bool isBase(const char c) {
+    switch (c) {
+        case 'A': case 'C': case 'G': case 'T':
+        case 'a': case 'c': case 'g': case 't':
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Hint the CPU to load @p address into the cache (no-op on compilers without the builtin)
+inline void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+} // namespace
+
+DeBruijnGraph::DeBruijnGraph(const std::string& text, const std::vector<uint32_t>& record_starts, const uint8_t k,
+                             const DeBruijnOptions& options)
+    : canonical(options.canonical), rolling(k) {
+    if (k < 2 || k > 32) throw std::invalid_argument("Invalid k!");
+    // every run of at least k bases becomes a record of the index, i.e. no k-mer spans a non-base
+    std::string runs;
+    std::vector<uint32_t> starts;
+    runs.reserve(text.size());
+    const std::vector<uint32_t> records = record_starts.empty() ? std::vector<uint32_t>{0} : record_starts;
+    for (size_t r = 0; r < records.size(); r++) {
+        const size_t end = (r + 1 < records.size()) ? records[r + 1] : text.size();
+        for (size_t i = records[r]; i < end;) {
+            while (i < end && !isBase(text[i])) i++;
+            size_t j = i;
+            while (j < end && isBase(text[j])) j++;
+            if (j - i >= k) {
+                starts.push_back(runs.size());
+                runs.append(text, i, j - i);
+            }
+            i = j;
+        }
+    }
+    if (starts.empty()) return;
+    QGramOptions index_options;
+    index_options.sparse = k > 13;
+    index_options.canonical = canonical;
+    const QGramIndex index(runs, starts, k, index_options);
+    fromIndex(index, options.min_count);
+}
+
+DeBruijnGraph::DeBruijnGraph(const QGramIndex& index, const uint32_t min_count)
+    : canonical(index.isCanonical()), rolling(index.getQ()) {
+    if (index.getWindow() > 1 || !index.getSeed().isContiguous())
+        throw std::invalid_argument("A de Bruijn graph needs all q-grams (no minimizers or spaced seeds)!");
+    if (index.getQ() < 2) throw std::invalid_argument("Invalid k!");
+    fromIndex(index, min_count);
+}
+
+void DeBruijnGraph::fromIndex(const QGramIndex& index, const uint32_t min_count) {
+    index.forEachBucket([&](const uint64_t h, const uint32_t count) {
+        if (count < min_count) return;
+        kmers.push_back(h);
+        counts.push_back(count);
+    });
+    // radix table over the leading bits of the (sorted) k-mers, about one k-mer per slot
+    const unsigned key_bits = 2 * getK();
+    unsigned bits = 1;
+    while (bits < 24 && bits < key_bits && (size_t(1) << bits) < kmers.size()) bits++;
+    radix_shift = key_bits - bits;
+    radix.resize((size_t(1) << bits) + 1);
+    size_t slot = 0;
+    for (size_t b = 0; b < radix.size(); b++) {
+        while (slot < kmers.size() && (kmers[slot] >> radix_shift) < b) slot++;
+        radix[b] = slot;
+    }
+    compact();
+}
+
+size_t DeBruijnGraph::slotOf(const uint64_t h) const {
+    return slotOfKey(keyOf(h));
+}
+
+size_t DeBruijnGraph::slotOfKey(const uint64_t key) const {
+    const size_t b = key >> radix_shift;
+    const auto begin = kmers.begin() + radix[b];
+    const auto end = kmers.begin() + radix[b + 1];
+    const auto it = std::lower_bound(begin, end, key);
+    return (it != end && *it == key) ? it - kmers.begin() : kmers.size();
+}
+
+uint32_t DeBruijnGraph::count(const uint64_t h) const {
+    if (kmers.empty() || h > rolling.maxHash()) return 0;
+    const size_t slot = slotOf(h);
+    return slot < kmers.size() ? counts[slot] : 0;
+}
+
+void DeBruijnGraph::findEdges() {
+    // 8 lookups per k-mer, each two cache misses (radix slot, then the k-mers): prefetch the radix slots of the
+    // neighbours of the k-mer DISTANCE ahead, and the k-mers they point to for the one DISTANCE / 2 ahead
+    const size_t DISTANCE = 8;
+    const size_t n = kmers.size();
+    const unsigned shift = 2 * (getK() - 1);
+    const auto neighbourKeys = [this, shift](const uint64_t h, uint64_t* keys) {
+        for (uint64_t c = 0; c < 4; c++) {
+            keys[c] = keyOf(((h << 2) | c) & rolling.maxHash());
+            keys[4 + c] = keyOf((c << shift) | (h >> 2));
+        }
+    };
+    edges.assign(n, 0);
+    #pragma omp parallel for schedule(static)
+    for (size_t s = 0; s < n; s++) {
+        uint64_t keys[8];
+        if (s + DISTANCE < n) {
+            neighbourKeys(kmers[s + DISTANCE], keys);
+            for (const uint64_t key : keys) prefetch(&radix[key >> radix_shift]);
+        }
+        if (s + DISTANCE / 2 < n) {
+            neighbourKeys(kmers[s + DISTANCE / 2], keys);
+            for (const uint64_t key : keys) prefetch(kmers.data() + radix[key >> radix_shift]);
+        }
+        neighbourKeys(kmers[s], keys);
+        uint8_t e = 0;
+        for (unsigned i = 0; i < 8; i++) {
+            if (slotOfKey(keys[i]) != n) e |= 1u << i;
+        }
+        edges[s] = e;
+    }
+}
+
+unsigned DeBruijnGraph::neighbours(const uint64_t h, const size_t slot, const bool forward, uint64_t& next) const {
+    unsigned bases = forward ? edges[slot] & 15 : edges[slot] >> 4;
+    if (h != kmers[slot]) {
+        // h is the reverse complement of the key: its successors are the reverse complements of the key's
+        // predecessors, and vice versa, with complemented bases (bit c -> bit 3 - c)
+        bases = forward ? edges[slot] >> 4 : edges[slot] & 15;
+        bases = ((bases & 1) << 3) | ((bases & 2) << 1) | ((bases & 4) >> 1) | ((bases & 8) >> 3);
+    }
+    const unsigned shift = 2 * (getK() - 1);
+    for (uint64_t c = 0; c < 4; c++) {
+        if (bases & (1u << c)) next = forward ? (((h << 2) | c) & rolling.maxHash()) : ((c << shift) | (h >> 2));
+    }
+    return __builtin_popcount(bases);
+}
+
+bool DeBruijnGraph::extends(const uint64_t h, const size_t slot, const uint64_t next, const size_t next_slot) const {
+    // no self loops and hairpins (next is h or its reverse complement); palindromes join both strands
+    if (slot == next_slot) return false;
+    if (canonical && (h == rolling.reverseComplement(h) || next == rolling.reverseComplement(next))) return false;
+    uint64_t other;
+    return neighbours(h, slot, true, other) == 1 && neighbours(next, next_slot, false, other) == 1;
+}
+
+bool DeBruijnGraph::startsUnitig(const uint64_t h, const size_t slot) const {
+    uint64_t previous;
+    return neighbours(h, slot, false, previous) != 1 || !extends(previous, slotOf(previous), h, slot);
+}
+
+Unitig DeBruijnGraph::walk(const uint64_t h, const size_t slot, std::vector<size_t>& path) const {
+    Unitig unitig{std::string(getK(), 'A'), h, h, 0};
+    for (unsigned i = 0; i < getK(); i++) unitig.sequence[i] = dna((h >> 2 * (getK() - 1 - i)) & 3);
+    path.clear();
+    uint64_t current = h;
+    size_t current_slot = slot;
+    for (;;) {
+        path.push_back(current_slot);
+        unitig.kmer_count += counts[current_slot];
+        uint64_t next;
+        if (neighbours(current, current_slot, true, next) != 1) break;
+        const size_t next_slot = slotOf(next);
+        if (next_slot == slot || !extends(current, current_slot, next, next_slot)) break;
+        unitig.sequence += dna(next & 3);
+        current = next;
+        current_slot = next_slot;
+    }
+    unitig.last = current;
+    return unitig;
+}
+
+void DeBruijnGraph::compact() {
+    findEdges();
+    const size_t n = kmers.size();
+    std::vector<uint8_t> done(n, 0); // every slot is written by the one thread that builds its unitig
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    std::vector<std::vector<Unitig>> found(threads);
+    #pragma omp parallel
+    {
+        int t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        std::vector<Unitig>& mine = found[t];
+        std::vector<size_t> path;
+        #pragma omp for schedule(dynamic, 4096)
+        for (size_t s = 0; s < n; s++) {
+            for (int strand = 0; strand < (canonical ? 2 : 1); strand++) {
+                const uint64_t h = strand ? rolling.reverseComplement(kmers[s]) : kmers[s];
+                if (strand && h == kmers[s]) continue; // palindrome
+                if (!startsUnitig(h, s)) continue;
+                Unitig unitig = walk(h, s, path);
+                // canonical: a unitig is also walked from its other end (if that starts a unitig as well), keep one
+                const uint64_t other_end = rolling.reverseComplement(unitig.last);
+                if (canonical && other_end < h && startsUnitig(other_end, path.back())) continue;
+                for (const size_t slot : path) done[slot] = 1;
+                mine.push_back(std::move(unitig));
+            }
+        }
+    }
+    for (auto& unitigs_of_thread : found) {
+        for (auto& unitig : unitigs_of_thread) unitigs.push_back(std::move(unitig));
+    }
+    // the rest are cycles without a start: every k-mer extends to the next one
+    std::vector<size_t> path;
+    for (size_t s = 0; s < n; s++) {
+        if (done[s]) continue;
+        unitigs.push_back(walk(kmers[s], s, path));
+        for (const size_t slot : path) done[slot] = 1;
+    }
+    std::sort(unitigs.begin(), unitigs.end(), [](const Unitig& a, const Unitig& b) { return a.first < b.first; });
+
+    // links only ever lead to the first or the last k-mer of a unitig
+    unitig_of.assign(n, 0);
+    for (uint32_t u = 0; u < unitigs.size(); u++) {
+        unitig_of[slotOf(unitigs[u].first)] = u;
+        unitig_of[slotOf(unitigs[u].last)] = u;
+    }
+}
+
+std::vector<std::tuple<uint32_t, bool, uint32_t, bool>> DeBruijnGraph::links() const {
+    std::vector<std::tuple<uint32_t, bool, uint32_t, bool>> result;
+    // a unitig that is its own reverse complement (a palindromic k-mer) has a single orientation
+    const auto selfReverse = [this](const uint32_t u) {
+        return canonical && unitigs[u].first == rolling.reverseComplement(unitigs[u].last);
+    };
+    for (uint32_t u = 0; u < unitigs.size(); u++) {
+        for (int strand = 0; strand < ((canonical && !selfReverse(u)) ? 2 : 1); strand++) {
+            const bool reversed = strand;
+            // the last k-mer of u in this orientation, and every k-mer following it
+            const uint64_t end = reversed ? rolling.reverseComplement(unitigs[u].first) : unitigs[u].last;
+            for (uint64_t c = 0; c < 4; c++) {
+                const uint64_t y = ((end << 2) | c) & rolling.maxHash();
+                const size_t slot = slotOf(y);
+                if (slot == kmers.size()) continue;
+                const uint32_t v = unitig_of[slot];
+                const bool v_reversed = (y != unitigs[v].first); // i.e. y is the reverse complement of its last k-mer
+                // the same link read from the other strand: (v, !v_reversed) -> (u, !reversed)
+                if (canonical && std::make_pair(v, !v_reversed && !selfReverse(v)) < std::make_pair(u, reversed)) continue;
+                result.emplace_back(u, reversed, v, v_reversed);
+            }
+        }
+    }
+    return result;
+}
+
+void DeBruijnGraph::writeGFA(std::ostream& out) const {
+    out << "H\tVN:Z:1.0\n";
+    for (size_t u = 0; u < unitigs.size(); u++) {
+        out << "S\t" << u << "\t" << unitigs[u].sequence << "\tLN:i:" << unitigs[u].sequence.size()
+            << "\tKC:i:" << unitigs[u].kmer_count << "\n";
+    }
+    for (const auto& [from, from_reversed, to, to_reversed] : links()) {
+        out << "L\t" << from << "\t" << (from_reversed ? '-' : '+') << "\t" << to << "\t" << (to_reversed ? '-' : '+')
+            << "\t" << getK() - 1 << "M\n";
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "QGramHash.hpp"
+#include "QGramIndex.hpp"
+
+/// Construction options of a DeBruijnGraph
+struct DeBruijnOptions
+{
+  /// Key every k-mer by min(hash, reverse complement hash), i.e. a bidirected graph of both strands
+  /// (reads come from either strand); otherwise the k-mers are taken as they are (one strand)
+  bool canonical = true;
+
+  /// k-mers occurring fewer times are dropped (e.g. 2 or 3 to remove sequencing errors)
+  uint32_t min_count = 1;
+};
+
+/// A maximal non-branching path of k-mers (see DeBruijnGraph)
+struct Unitig
+{
+  std::string sequence;  ///< spelled by the path: k + (number of k-mers - 1) characters
+  uint64_t first;        ///< hash of the first k-mer, in the orientation of sequence
+  uint64_t last;         ///< hash of the last k-mer, in the orientation of sequence
+  uint64_t kmer_count;   ///< sum of the counts (occurrences) of its k-mers
+};
+
+/**
+   Compacted de Bruijn graph of the k-mers (k from 2 to 32) of a set of sequences: nodes are the (k-1)-mers,
+   every distinct k-mer is an edge between its prefix and its suffix, weighted by its count. Non-branching paths
+   are compacted into unitigs, i.e. the result is the unitig graph, written as GFA (writeGFA()): a segment per
+   unitig, a link (overlap k-1) per edge between unitigs.
+
+   The k-mers and their counts come from the directory of a QGramIndex with q = k (counting sort over the rolling
+   hash, see QGramIndex::forEachBucket()); the suffix array is not needed afterwards, so only the sorted distinct
+   k-mers, their counts and their edges (which of the 4 + 4 possible neighbours exist, one byte) are kept.
+   Compaction runs in parallel (OpenMP): every thread takes a share of the k-mers and walks the unitig from each
+   one that starts a unitig (i.e. cannot be extended to the left), so every unitig is built by exactly one thread
+   without any locking; a walk takes one lookup per k-mer. k-mers left over afterwards lie on cycles
+   without a start and are compacted sequentially. The result is identical for any number of threads.
+
+   In canonical mode, a k-mer and its reverse complement are the same edge and unitigs may be traversed in
+   both orientations (links carry orientations); palindromic k-mers (even k) always end their unitig.
+*/
+class DeBruijnGraph
+{
+public:
+    /**
+     @brief Build the graph of the k-mers of the sequences in @p text (concatenated, starting at @p record_starts,
+     see QGramIndex). No k-mer spans two records; k-mers with other characters than ACGT (either case) are skipped.
+     @throws std::invalid_argument("Invalid k!") unless 2 <= k <= 32
+    */
+    DeBruijnGraph(const std::string& text, const std::vector<uint32_t>& record_starts, const uint8_t k,
+                  const DeBruijnOptions& options = DeBruijnOptions());
+
+    /**
+     @brief Build the graph from the directory of @p index (q = k; contiguous q-grams, no minimizers). The graph is
+     canonical if the index is; QGramIndex maps other characters than ACGT to 'A', i.e. use the text constructor
+     to skip them.
+     @throws std::invalid_argument if the index is a minimizer or spaced seed index, or q < 2
+    */
+    DeBruijnGraph(const QGramIndex& index, const uint32_t min_count = 1);
+
+    /// Unitigs, ordered by the hash of their first k-mer
+    const std::vector<Unitig>& getUnitigs() const { return unitigs; }
+
+    /// Number of distinct k-mers (edges) in the graph
+    size_t kmerCount() const { return kmers.size(); }
+
+    /// Count of the k-mer with hash @p h (canonical: either strand); 0 if it is not in the graph
+    uint32_t count(const uint64_t h) const;
+
+    /**
+     @brief Links between unitigs: (from, from reversed, to, to reversed), i.e. the last k-1 characters of unitig
+     from (reverse complemented if reversed) are the first k-1 characters of unitig to (likewise). Every link is
+     listed once (in canonical mode, a link and its reverse complement are the same).
+    */
+    std::vector<std::tuple<uint32_t, bool, uint32_t, bool>> links() const;
+
+    /**
+     @brief Write the graph as GFA 1.0: a header, "S <id> <sequence> LN:i:<length> KC:i:<k-mer count>" per unitig
+     (ids are the indexes into getUnitigs()), then "L <from> <+|-> <to> <+|-> <k-1>M" per link (see links()).
+    */
+    void writeGFA(std::ostream& out) const;
+
+    uint8_t getK() const { return rolling.getQ(); }
+
+    bool isCanonical() const { return canonical; }
+
+private:
+    /// Take the k-mers with at least @p min_count occurrences from @p index, then compact()
+    void fromIndex(const QGramIndex& index, const uint32_t min_count);
+    /// Build the unitigs
+    void compact();
+    /// Slot of the k-mer with oriented hash @p h in kmers; kmers.size() if it is not in the graph
+    size_t slotOf(const uint64_t h) const;
+    /// Slot of the k-mer with key @p key (see keyOf())
+    size_t slotOfKey(const uint64_t key) const;
+    /// Key of an oriented k-mer (canonical: the smaller of both strands)
+    uint64_t keyOf(const uint64_t h) const { return canonical ? std::min(h, rolling.reverseComplement(h)) : h; }
+    /// Compute edges (looks up the 8 possible neighbours of every k-mer, in parallel)
+    void findEdges();
+    /// Number of k-mers following (@p forward) or preceding oriented k-mer @p h in @p slot; the last one found goes
+    /// to @p next (from edges, no lookup)
+    unsigned neighbours(const uint64_t h, const size_t slot, const bool forward, uint64_t& next) const;
+    /// Whether the unitig may continue from oriented k-mer @p h to its only successor @p next (in the given slots)
+    bool extends(const uint64_t h, const size_t slot, const uint64_t next, const size_t next_slot) const;
+    /// Whether oriented k-mer @p h in @p slot starts a unitig, i.e. no k-mer extends to it
+    bool startsUnitig(const uint64_t h, const size_t slot) const;
+    /// Walk the unitig starting at oriented k-mer @p h in @p slot; its slots go to @p path
+    Unitig walk(const uint64_t h, const size_t slot, std::vector<size_t>& path) const;
+
+    const bool canonical;
+    const RollingHash rolling;
+    std::vector<uint64_t> kmers;   ///< distinct k-mers (keys), sorted
+    std::vector<uint32_t> counts;  ///< count of every k-mer
+    std::vector<uint8_t> edges;    ///< per k-mer (as in kmers): bit c = base c may follow, bit 4 + c = may precede
+    std::vector<uint32_t> radix;   ///< radix[b] = first k-mer whose leading bits are b
+    unsigned radix_shift = 0;      ///< 2k - number of leading bits of the radix table
+    std::vector<Unitig> unitigs;
+    std::vector<uint32_t> unitig_of; ///< by slot: unitig of the first and the last k-mer of every unitig (the others: 0)
+};
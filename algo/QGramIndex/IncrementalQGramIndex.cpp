@@ -0,0 +1,122 @@
+#include "IncrementalQGramIndex.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+IncrementalQGramIndex::IncrementalQGramIndex(const uint8_t q, const QGramOptions& options, const uint32_t merge_ratio)
+    : q_length(q), options(options), merge_ratio(std::max<uint32_t>(merge_ratio, 1)) {
+    if (q_length < 1 || q_length > (options.sparse ? 32 : 13)) throw std::invalid_argument("Invalid q!");
+}
+
+namespace {
+
+/// The options a QGramIndex was built with
+QGramOptions optionsOf(const QGramIndex& index) {
+    QGramOptions options;
+    options.sparse = index.isSparse();
+    options.window = index.getWindow();
+    options.canonical = index.isCanonical();
+    if (!index.getSeed().isContiguous()) options.seed_mask = index.getSeed().getMask();
+    return options;
+}
+
+} // namespace
+
+IncrementalQGramIndex::IncrementalQGramIndex(QGramIndex&& base, const uint32_t merge_ratio)
+    : q_length(base.getQ()), options(optionsOf(base)), merge_ratio(std::max<uint32_t>(merge_ratio, 1)) {
+    text_length = base.getTextView().size();
+    record_count = base.getRecordCount();
+    segments.push_back(Segment{nullptr, std::make_unique<QGramIndex>(std::move(base)), 0, 0});
+}
+
+void IncrementalQGramIndex::add(const std::vector<std::string>& sequences) {
+    if (sequences.empty()) return;
+    auto text = std::make_unique<std::string>();
+    std::vector<uint32_t> starts;
+    size_t length = 0;
+    for (const auto& seq : sequences) length += seq.size();
+    const size_t limit = options.canonical ? QGramIndex::STRAND_BIT - 1 : std::numeric_limits<uint32_t>::max();
+    if (text_length + length > limit) throw std::invalid_argument("Text too long!");
+    text->reserve(length);
+    for (const auto& seq : sequences) {
+        starts.push_back(text->size());
+        *text += seq;
+    }
+    // deltas get the sparse directory: a dense one has 4^q entries however small the segment (merging a delta into
+    // a dense segment gives a dense one)
+    QGramOptions segment_options = options;
+    if (!segments.empty()) segment_options.sparse = true;
+    auto index = std::make_unique<QGramIndex>(*text, starts, q_length, segment_options);
+    segments.push_back(Segment{std::move(text), std::move(index), uint32_t(text_length), uint32_t(record_count)});
+    text_length += length;
+    record_count += sequences.size();
+
+    // merge while the newest segment has caught up with the one before it
+    while (segments.size() >= 2) {
+        const size_t older = segments[segments.size() - 2].index->getTextView().size();
+        const size_t newer = segments.back().index->getTextView().size();
+        if (uint64_t(newer) * merge_ratio < older) break;
+        mergeSegments(segments.size() - 2);
+    }
+}
+
+void IncrementalQGramIndex::mergeSegments(const size_t i) {
+    Segment& first = segments[i];
+    Segment& second = segments[i + 1];
+    auto text = std::make_unique<std::string>();
+    text->reserve(first.index->getTextView().size() + second.index->getTextView().size());
+    text->append(first.index->getTextView());
+    text->append(second.index->getTextView());
+    auto merged = std::make_unique<QGramIndex>(QGramIndex::merge(*text, *first.index, *second.index));
+    first.index = std::move(merged); // first the index, then the text it was referencing
+    first.text = std::move(text);
+    segments.erase(segments.begin() + i + 1);
+}
+
+void IncrementalQGramIndex::compact() {
+    while (segments.size() >= 2) mergeSegments(segments.size() - 2);
+}
+
+void IncrementalQGramIndex::save(const std::string& filename) {
+    if (segments.empty()) throw std::runtime_error("Cannot save an empty index!");
+    compact();
+    segments[0].index->save(filename);
+}
+
+std::vector<uint32_t> IncrementalQGramIndex::getHits64(const uint64_t h) const {
+    if (h > RollingHash(q_length).maxHash()) throw std::invalid_argument("Invalid hash!");
+    std::vector<uint32_t> hits;
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        // positions stay below 2^31 in a canonical index, i.e. adding the offset keeps the strand bit
+        for (const uint32_t hit : it->index->getHitsView(h)) hits.push_back(hit + it->offset);
+    }
+    return hits;
+}
+
+std::vector<uint32_t> IncrementalQGramIndex::find(const std::string& pattern, const bool both_strands) const {
+    std::vector<uint32_t> hits;
+    for (const auto& segment : segments) {
+        // occurrences never span two records, hence never two segments
+        for (const uint32_t hit : segment.index->find(pattern, both_strands)) hits.push_back(hit + segment.offset);
+    }
+    return hits;
+}
+
+size_t IncrementalQGramIndex::sizeInBytes() const {
+    size_t bytes = 0;
+    for (const auto& segment : segments) bytes += segment.index->sizeInBytes();
+    return bytes;
+}
+
+const IncrementalQGramIndex::Segment& IncrementalQGramIndex::segmentAt(const uint32_t pos) const {
+    const auto it = std::upper_bound(segments.begin(), segments.end(), pos,
+                                     [](const uint32_t p, const Segment& s) { return p < s.offset; });
+    return *(it - 1);
+}
+
+std::pair<uint32_t, uint32_t> IncrementalQGramIndex::resolve(const uint32_t pos) const {
+    if (pos >= text_length) throw std::invalid_argument("Invalid position!");
+    const Segment& segment = segmentAt(pos);
+    const auto [record, offset] = segment.index->resolve(pos - segment.offset);
+    return {segment.first_record + record, offset};
+}
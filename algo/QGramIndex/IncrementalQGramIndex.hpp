@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "QGramIndex.hpp"
+
+/**
+   A q-gram index that grows by appending batches of records, without rebuilding what is already indexed.
+
+   The index is a list of segments (LSM-style), oldest first: a base index (built, or loaded via QGramIndex::load())
+   followed by smaller delta segments, one per add(). After every add(), the newest segments are merged
+   (QGramIndex::merge(), bucket by bucket, no rehashing) as long as the newer one has grown to at least 1/merge_ratio
+   of the older one. Segment sizes thus decrease geometrically, there are O(log n) segments, and every position
+   is merged O(log n) times. compact() merges everything into a single index (e.g. before save()).
+   Delta segments always use the sparse directory, whose size follows the segment (a dense one takes 4^q entries
+   even for a single read); a merge with a dense segment gives a dense one, i.e. the base keeps its directory.
+
+   Positions are global: records are numbered and laid out in the order they were added, as if all records
+   had been concatenated into one text. Queries visit every segment, newest first.
+*/
+class IncrementalQGramIndex
+{
+public:
+    /**
+     @brief An empty index.
+     @param q Length of q-grams (see QGramIndex)
+     @param options Construction options of the first segment (later ones only differ in using the sparse directory)
+     @param merge_ratio Merge the two newest segments if the newer one is at least 1/merge_ratio of the older one (>= 1)
+     @throws std::invalid_argument("Invalid q!") if q is out of range
+    */
+    IncrementalQGramIndex(const uint8_t q, const QGramOptions& options = QGramOptions(), const uint32_t merge_ratio = 4);
+
+    /**
+     @brief Start from an existing index as base segment, e.g. one opened via QGramIndex::load().
+
+     The base index is never modified; its text must outlive this object if it references one (see QGramIndex).
+     New segments use the options of the base index.
+    */
+    explicit IncrementalQGramIndex(QGramIndex&& base, const uint32_t merge_ratio = 4);
+
+    IncrementalQGramIndex(IncrementalQGramIndex&&) = default;
+
+    /**
+     @brief Append a batch of records (each a sequence; no q-gram spans two records) as a new segment,
+     then merge segments as needed.
+     @throws std::invalid_argument if the total text would exceed 2^32 (canonical: 2^31) characters
+    */
+    void add(const std::vector<std::string>& sequences);
+
+    /// Merge all segments into one
+    void compact();
+
+    /// compact(), then write the index to @p filename (see QGramIndex::save(); open it again with QGramIndex::load())
+    void save(const std::string& filename);
+
+    /**
+      @brief Hits of the q-gram with hash @p h in all segments, in decreasing order (as QGramIndex::getHits64()).
+      @throws std::invalid_argument("Invalid hash!"); if h is outside of valid hash values
+    */
+    std::vector<uint32_t> getHits64(const uint64_t h) const;
+
+    /**
+      @brief All occurrences of @p pattern in increasing order (see QGramIndex::find()).
+      @throws std::invalid_argument as QGramIndex::find()
+    */
+    std::vector<uint32_t> find(const std::string& pattern, const bool both_strands = false) const;
+
+    /**
+      @brief Map a global position to (record id, offset within the record).
+      @throws std::invalid_argument("Invalid position!") if pos is outside of the text
+    */
+    std::pair<uint32_t, uint32_t> resolve(const uint32_t pos) const;
+
+    /// Total length of all records
+    size_t textLength() const { return text_length; }
+
+    /// Number of records added (including those of the base index)
+    size_t getRecordCount() const { return record_count; }
+
+    /// Number of segments (one after compact())
+    size_t segmentCount() const { return segments.size(); }
+
+    /// Memory of all segments in bytes (see QGramIndex::sizeInBytes())
+    size_t sizeInBytes() const;
+
+    uint8_t getQ() const { return q_length; }
+
+private:
+    struct Segment {
+        std::unique_ptr<std::string> text;  ///< text of the segment (nullptr: the base index references its own)
+        std::unique_ptr<QGramIndex> index;
+        uint32_t offset;                    ///< start of the segment in the global text
+        uint32_t first_record;              ///< id of the first record of the segment
+    };
+
+    /// Merge segments i and i+1
+    void mergeSegments(const size_t i);
+    /// Segment holding global position @p pos
+    const Segment& segmentAt(const uint32_t pos) const;
+
+    const uint8_t q_length;
+    const QGramOptions options;
+    const uint32_t merge_ratio;
+    std::vector<Segment> segments;  ///< oldest first
+    size_t text_length = 0;
+    size_t record_count = 0;
+};
@@ -0,0 +1,259 @@
+#include "KmerCounter.hpp"
+#include "qg_fasta.hpp"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// A partition is reduced once it has at least this many pending k-mers (and more than distinct ones)
+const size_t MIN_PENDING = 1 << 12;
+
+/// Whether @p c is a base (ACGTU, any case); k-mers with other characters are not counted
+inline bool isBase(const char c) {
+    switch (c) {
+        case 'A': case 'C': case 'G': case 'T': case 'U':
+        case 'a': case 'c': case 'g': case 't': case 'u':
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char MAGIC[8] = {'K', 'M', 'E', 'R', 'C', 'N', 'T', '\0'};
+const uint32_t FILE_VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304; // written natively; reads back differently on a machine with other endianness
+
+/// Header of a count table; followed by the hashes (uint64_t) and the counts (uint32_t) of all entries
+struct TableHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t k;
+    uint32_t flags;    // bit 0: canonical
+    uint64_t entries;
+    uint64_t total;    // number of k-mers counted
+};
+
+} // namespace
+
+KmerCounter::KmerCounter(const uint8_t k, const KmerOptions& options)
+    : canonical(options.canonical), rolling(k),
+      partition_shift(2*k - std::clamp<uint8_t>(options.partition_bits, 1, std::max(2*k, 1))),
+      batch_size(std::max<size_t>(options.batch_size, 1)) {
+    if (k < 1 || k > 32) throw std::invalid_argument("Invalid k!");
+    partitions.resize((rolling.maxHash() >> partition_shift) + 1);
+}
+
+void KmerCounter::hashRead(const std::string& read, std::vector<std::vector<uint64_t>>& buffers) const {
+    // The rolling hashes need no restart after an invalid character: k valid ones shift out everything before
+    const size_t k = getK();
+    size_t run = 0;
+    uint64_t h = 0, rc = 0;
+    for (const char c : read) {
+        if (!isBase(c)) {
+            run = 0;
+            continue;
+        }
+        h = rolling.next(h, c);
+        if (canonical) rc = rolling.nextRC(rc, c);
+        if (++run < k) continue;
+        const uint64_t key = canonical ? std::min(h, rc) : h;
+        buffers[key >> partition_shift].push_back(key);
+    }
+}
+
+void KmerCounter::add(const std::vector<std::string>& reads) {
+    int threads = 1;
+#ifdef _OPENMP
+    threads = std::max<int>(1, std::min<size_t>(omp_get_max_threads(), reads.size()));
+#endif
+    // 1. Every thread hashes its reads into its own buffer per partition
+    std::vector<std::vector<std::vector<uint64_t>>> buffers(threads, std::vector<std::vector<uint64_t>>(partitions.size()));
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t i = 0; i < reads.size(); i++) hashRead(reads[i], buffers[t]);
+    }
+
+    // 2. Collect the buffers per partition; reduce partitions with more pending than distinct k-mers
+    uint64_t added = 0;
+    #pragma omp parallel for schedule(dynamic, 16) reduction(+:added)
+    for (size_t p = 0; p < partitions.size(); p++) {
+        Partition& partition = partitions[p];
+        for (int t = 0; t < threads; t++) {
+            partition.pending.insert(partition.pending.end(), buffers[t][p].begin(), buffers[t][p].end());
+            added += buffers[t][p].size();
+            std::vector<uint64_t>().swap(buffers[t][p]);
+        }
+        if (partition.pending.size() >= std::max(MIN_PENDING, partition.kmers.size())) reduce(partition);
+    }
+    total_kmers += added;
+}
+
+void KmerCounter::flush() {
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (size_t p = 0; p < partitions.size(); p++) {
+        if (!partitions[p].pending.empty()) reduce(partitions[p]);
+    }
+}
+
+void KmerCounter::reduce(Partition& partition) {
+    std::vector<uint64_t>& pending = partition.pending;
+    std::sort(pending.begin(), pending.end());
+    std::vector<uint64_t> kmers;
+    std::vector<uint32_t> counts;
+    kmers.reserve(partition.kmers.size() + pending.size());
+    counts.reserve(partition.kmers.size() + pending.size());
+    // merge the runs of equal pending k-mers into the sorted counts
+    size_t i = 0, j = 0;
+    while (i < partition.kmers.size() || j < pending.size()) {
+        if (j == pending.size() || (i < partition.kmers.size() && partition.kmers[i] < pending[j])) {
+            kmers.push_back(partition.kmers[i]);
+            counts.push_back(partition.counts[i]);
+            i++;
+            continue;
+        }
+        const uint64_t kmer = pending[j];
+        uint64_t count = 0;
+        for (; j < pending.size() && pending[j] == kmer; j++) count++;
+        if (i < partition.kmers.size() && partition.kmers[i] == kmer) count += partition.counts[i++];
+        kmers.push_back(kmer);
+        counts.push_back(uint32_t(std::min<uint64_t>(count, std::numeric_limits<uint32_t>::max())));
+    }
+    kmers.shrink_to_fit();
+    counts.shrink_to_fit();
+    partition.kmers.swap(kmers);
+    partition.counts.swap(counts);
+    std::vector<uint64_t>().swap(pending);
+}
+
+size_t KmerCounter::count(std::istream& reads) {
+    SequenceReader reader(reads);
+    std::vector<std::string> batch(batch_size);
+    std::string name;
+    size_t n = 0, total = 0;
+    while (true) {
+        for (n = 0; n < batch_size && reader.next(name, batch[n]); n++) {}
+        if (n == 0) break;
+        batch.resize(n);
+        add(batch);
+        total += n;
+        if (n < batch_size) break;
+    }
+    flush();
+    return total;
+}
+
+uint32_t KmerCounter::count(uint64_t h) const {
+    if (h > rolling.maxHash()) throw std::invalid_argument("Invalid hash!");
+    if (canonical) h = std::min(h, rolling.reverseComplement(h));
+    const Partition& partition = partitions[h >> partition_shift];
+    const auto it = std::lower_bound(partition.kmers.begin(), partition.kmers.end(), h);
+    if (it == partition.kmers.end() || *it != h) return 0;
+    return partition.counts[it - partition.kmers.begin()];
+}
+
+uint32_t KmerCounter::count(const std::string& kmer) const {
+    if (kmer.size() != getK()) throw std::invalid_argument("Invalid k-mer. Wrong length!");
+    if (!std::all_of(kmer.begin(), kmer.end(), isBase)) return 0;
+    return count(rolling.hash(kmer.data()));
+}
+
+std::vector<uint64_t> KmerCounter::histogram(const size_t max_count) const {
+    std::vector<uint64_t> histogram(std::max<size_t>(max_count, 2), 0);
+    forEach([&histogram](uint64_t, const uint32_t count) {
+        histogram[std::min<size_t>(count, histogram.size() - 1)]++;
+    });
+    return histogram;
+}
+
+size_t KmerCounter::distinct() const {
+    size_t distinct = 0;
+    for (const auto& partition : partitions) distinct += partition.kmers.size();
+    return distinct;
+}
+
+void KmerCounter::save(const std::string& filename) const {
+    TableHeader header{};
+    std::copy(MAGIC, MAGIC + 8, header.magic);
+    header.version = FILE_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.k = getK();
+    header.flags = canonical ? 1 : 0;
+    header.entries = distinct();
+    header.total = total_kmers;
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot write count table '" + filename + "'!");
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& partition : partitions)
+        out.write(reinterpret_cast<const char*>(partition.kmers.data()), partition.kmers.size() * sizeof(uint64_t));
+    for (const auto& partition : partitions)
+        out.write(reinterpret_cast<const char*>(partition.counts.data()), partition.counts.size() * sizeof(uint32_t));
+    if (!out.flush()) throw std::runtime_error("Cannot write count table '" + filename + "'!");
+}
+
+KmerCounter KmerCounter::load(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open count table '" + filename + "'!");
+    const auto invalid = [&filename](const std::string& why) {
+        return std::runtime_error("Invalid count table '" + filename + "': " + why);
+    };
+    TableHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) throw invalid("truncated");
+    if (!std::equal(MAGIC, MAGIC + 8, header.magic)) throw invalid("not a k-mer count table");
+    if (header.byte_order != BYTE_ORDER_MARK) throw invalid("written on a machine with different byte order");
+    if (header.version != FILE_VERSION) throw invalid("unsupported version " + std::to_string(header.version));
+    if (header.k < 1 || header.k > 32) throw invalid("bad k");
+    const std::streampos data_start = in.tellg();
+    in.seekg(0, std::ios::end);
+    if (uint64_t(in.tellg() - data_start) != header.entries * (sizeof(uint64_t) + sizeof(uint32_t))) throw invalid("truncated");
+    in.seekg(data_start);
+
+    KmerOptions options;
+    options.canonical = header.flags & 1;
+    KmerCounter counter(header.k, options);
+    std::vector<uint64_t> kmers(header.entries);
+    std::vector<uint32_t> counts(header.entries);
+    in.read(reinterpret_cast<char*>(kmers.data()), kmers.size() * sizeof(uint64_t));
+    in.read(reinterpret_cast<char*>(counts.data()), counts.size() * sizeof(uint32_t));
+    if (!in) throw invalid("truncated");
+    if (!std::is_sorted(kmers.begin(), kmers.end()) || std::adjacent_find(kmers.begin(), kmers.end()) != kmers.end()
+        || (!kmers.empty() && kmers.back() > counter.rolling.maxHash())) throw invalid("bad k-mers");
+
+    // split the sorted table into partitions
+    size_t begin = 0;
+    for (size_t p = 0; p < counter.partitions.size(); p++) {
+        size_t end = begin;
+        while (end < kmers.size() && (kmers[end] >> counter.partition_shift) == p) end++;
+        Partition& partition = counter.partitions[p];
+        partition.kmers.assign(kmers.begin() + begin, kmers.begin() + end);
+        partition.counts.assign(counts.begin() + begin, counts.begin() + end);
+        begin = end;
+    }
+    counter.total_kmers = header.total;
+    return counter;
+}
+
+uint64_t estimateGenomeSize(const std::vector<uint64_t>& histogram) {
+    if (histogram.size() < 3) return 0;
+    // the error k-mers (count 1, 2, ...) decline towards the first minimum
+    size_t valley = 1;
+    while (valley + 1 < histogram.size() && histogram[valley + 1] < histogram[valley]) valley++;
+    // coverage peak; the last entry collects all high counts and is no peak
+    const auto peak = std::max_element(histogram.begin() + valley, histogram.end() - 1);
+    const size_t coverage = peak - histogram.begin();
+    if (peak == histogram.end() - 1 || coverage <= valley || *peak == 0) return 0;
+    uint64_t kmers = 0;
+    for (size_t c = valley; c < histogram.size(); c++) kmers += c * histogram[c];
+    return kmers / coverage;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "QGramHash.hpp"
+
+/// Construction options of a KmerCounter
+struct KmerOptions
+{
+  /// Count a k-mer and its reverse complement together, keyed by min(hash, reverse complement hash)
+  /// (reads come from either strand)
+  bool canonical = true;
+
+  /// Number of partitions: 2^partition_bits, by the leading bits of the k-mer hash (at most 2k)
+  uint8_t partition_bits = 10;
+
+  /// Number of reads per parallel batch when counting a stream (see KmerCounter::count(std::istream&))
+  size_t batch_size = 1 << 16;
+};
+
+/**
+   Counts the k-mers (k up to 32) of a set of reads, using the same 2-bit rolling hash as QGramIndex (RollingHash).
+
+   k-mers are partitioned by the leading bits of their hash: every thread hashes its share of a batch of reads
+   into its own per-partition buffers (no locking), then every partition is sorted and reduced to (k-mer, count)
+   pairs, which are merged into the partition's counts. A partition is only reduced once its pending k-mers
+   outnumber its distinct k-mers, so sorting stays O(n log n) overall, and memory is bounded by the distinct
+   k-mers plus one batch, not the input. Since partitions are ordered by leading bits, the counts are sorted by
+   hash as a whole.
+
+   k-mers containing characters other than ACGTU (e.g. N) are skipped. Counts saturate at 2^32 - 1.
+*/
+class KmerCounter
+{
+public:
+    /**
+     @brief Create an empty counter.
+     @param k Length of k-mers (from 1 to 32)
+     @throws std::invalid_argument("Invalid k!") unless 1 <= k <= 32
+    */
+    explicit KmerCounter(const uint8_t k, const KmerOptions& options = KmerOptions());
+
+    /**
+     @brief Count the k-mers of all reads of a FASTA/FASTQ stream (see SequenceReader), batch by batch.
+     @return the number of reads
+    */
+    size_t count(std::istream& reads);
+
+    /// Count the k-mers of a batch of reads (in parallel); call flush() before querying
+    void add(const std::vector<std::string>& reads);
+
+    /// Reduce all pending k-mers into the counts; count(std::istream&) does this at the end
+    void flush();
+
+    /// Count of the k-mer with hash @p h (canonical: either strand); 0 if it does not occur
+    uint32_t count(const uint64_t h) const;
+
+    /// Count of @p kmer (of length k)
+    /// @throws std::invalid_argument if @p kmer does not have length k
+    uint32_t count(const std::string& kmer) const;
+
+    /// Visit every distinct k-mer as visit(hash, count), in increasing order of hash
+    template <typename Visit>
+    void forEach(Visit&& visit) const {
+        for (const auto& partition : partitions) {
+            for (size_t i = 0; i < partition.kmers.size(); i++) visit(partition.kmers[i], partition.counts[i]);
+        }
+    }
+
+    /// k-mer spectrum: histogram[c] = number of distinct k-mers occurring c times, for c < @p max_count;
+    /// the last entry collects all k-mers occurring at least max_count - 1 times
+    std::vector<uint64_t> histogram(const size_t max_count = 10001) const;
+
+    /// Number of distinct k-mers
+    size_t distinct() const;
+
+    /// Number of k-mers counted (sum of all counts)
+    uint64_t total() const { return total_kmers; }
+
+    uint8_t getK() const { return rolling.getQ(); }
+
+    bool isCanonical() const { return canonical; }
+
+    /**
+     @brief Write the counts as a binary table to @p filename: a header (magic "KMERCNT\0", version, k, flags,
+     number of entries), then all hashes (uint64_t), then all counts (uint32_t), both sorted by hash.
+     @throws std::runtime_error if the file cannot be written
+    */
+    void save(const std::string& filename) const;
+
+    /// Read a table written by save()
+    /// @throws std::runtime_error if the file cannot be read or is not a valid table
+    static KmerCounter load(const std::string& filename);
+
+private:
+    struct Partition {
+        std::vector<uint64_t> pending; ///< k-mers not yet counted
+        std::vector<uint64_t> kmers;   ///< distinct k-mers, sorted
+        std::vector<uint32_t> counts;  ///< count of every k-mer
+    };
+
+    /// Sort and reduce the pending k-mers of @p partition and merge them into its counts
+    static void reduce(Partition& partition);
+
+    /// Append the k-mers of @p read to @p buffers (one per partition)
+    void hashRead(const std::string& read, std::vector<std::vector<uint64_t>>& buffers) const;
+
+    const bool canonical;
+    const RollingHash rolling;
+    const uint8_t partition_shift;
+    const size_t batch_size;
+    std::vector<Partition> partitions;
+    uint64_t total_kmers = 0;
+};
+
+/**
+   Estimate the genome size from a k-mer spectrum (see KmerCounter::histogram()): skip the error k-mers up to the
+   first minimum of the histogram, take the coverage peak c after it, and divide the number of k-mers beyond the
+   minimum by c. Returns 0 if the spectrum has no such peak (e.g. too little coverage).
+*/
+uint64_t estimateGenomeSize(const std::vector<uint64_t>& histogram);
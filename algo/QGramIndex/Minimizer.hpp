@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include "QGramHash.hpp"
+
+/// Order of q-grams for minimizer selection: an invertible mix of the hash (splitmix64 finalizer),
+/// so that low-complexity q-grams like AAA...A do not win every window
+inline uint64_t minimizerOrder(uint64_t h)
+{
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/**
+   Call emit(position, hash, reverse) for the (w,q)-minimizers of @p seq: of every window of @p w consecutive q-grams,
+   the one with the smallest minimizerOrder() (the leftmost on ties). A sequence with fewer than w q-grams
+   forms a single window.
+   With @p canonical, every q-gram is keyed by min(hash, reverse complement hash) (both rolled along), and
+   reverse tells whether the q-gram is the larger of the two; otherwise, reverse is always false.
+
+   Positions are reported once each, in increasing order. Only positions in [emit_begin, emit_end) are reported,
+   scanning just the windows that contain them, so a sequence can be split into chunks that are processed
+   independently (e.g. by several threads) without missing or duplicating a minimizer.
+
+   Uses a monotone deque (a ring buffer of w entries): O(1) amortized per q-gram.
+*/
+template <typename Emit>
+void forEachMinimizer(const char* seq, const size_t length, const RollingHash& rolling, const uint32_t w, const bool canonical,
+                      const size_t emit_begin, const size_t emit_end, Emit&& emit)
+{
+    const size_t q = rolling.getQ();
+    if (length < q || w == 0) return;
+    const size_t qgrams = length - q + 1;
+    const size_t end = std::min(emit_end, qgrams);
+    if (emit_begin >= end) return;
+    // q-grams of all windows containing a position in [emit_begin, end)
+    const size_t scan_begin = (emit_begin >= w - 1) ? emit_begin - (w - 1) : 0;
+    const size_t scan_end = std::min(qgrams, end + w - 1);
+
+    struct Entry { uint64_t order; uint64_t hash; size_t pos; bool reverse; };
+    std::vector<Entry> ring(w);
+    size_t head = 0, size = 0; // deque = ring[head], ring[head+1], ... (mod w), orders non-decreasing front to back
+    size_t last = ~size_t(0);
+    uint64_t h = 0, rc = 0;
+    for (size_t i = scan_begin; i < scan_end; i++) {
+        h = (i == scan_begin) ? rolling.hash(seq + i) : rolling.next(h, seq[i + q - 1]);
+        if (canonical) rc = (i == scan_begin) ? rolling.hashRC(seq + i) : rolling.nextRC(rc, seq[i + q - 1]);
+        const bool reverse = canonical && rc < h;
+        const uint64_t key = reverse ? rc : h;
+        const uint64_t order = minimizerOrder(key);
+        // drop q-grams that left the window, and those that can never win against the new one
+        if (size > 0 && ring[head].pos + w <= i) { head = (head + 1) % w; size--; }
+        while (size > 0 && ring[(head + size - 1) % w].order > order) size--;
+        ring[(head + size) % w] = Entry{order, key, i, reverse};
+        size++;
+        // the window ending at i is complete (or the sequence is shorter than one window)
+        if (i >= scan_begin + w - 1 || (scan_begin == 0 && i + 1 == qgrams)) {
+            const Entry& min = ring[head];
+            if (min.pos != last && min.pos >= emit_begin && min.pos < end) emit(min.pos, min.hash, min.reverse);
+            last = min.pos;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#include "PackedText.hpp"
+#include "qg_util.hpp"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/// Pack the 32 characters at @p text (2 bits each, first one most significant); clears @p exact on a non-ACGT character
+inline uint64_t packWord(const char* text, bool& exact) {
+#ifdef __SSE2__
+    uint64_t result = 0;
+    for (int half = 0; half < 2; half++) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 16 * half));
+        const __m128i upper = _mm_and_si128(chars, _mm_set1_epi8(char(0xDF))); // a|c|g|t|u -> A|C|G|T|U
+        const __m128i is_c = _mm_cmpeq_epi8(upper, _mm_set1_epi8('C'));
+        const __m128i is_g = _mm_cmpeq_epi8(upper, _mm_set1_epi8('G'));
+        const __m128i is_t = _mm_or_si128(_mm_cmpeq_epi8(upper, _mm_set1_epi8('T')), _mm_cmpeq_epi8(upper, _mm_set1_epi8('U')));
+        // exact: the characters are ACGT, either case (U is packed as T but is no exact base)
+        const __m128i acgt = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(upper, _mm_set1_epi8('A')), is_c),
+                                          _mm_or_si128(is_g, _mm_cmpeq_epi8(upper, _mm_set1_epi8('T'))));
+        if (_mm_movemask_epi8(acgt) != 0xFFFF) exact = false;
+        // one 2-bit code per byte: C = 1, G = 2, T|U = 3, anything else 0
+        __m128i codes = _mm_or_si128(_mm_and_si128(is_c, _mm_set1_epi8(1)),
+                                     _mm_or_si128(_mm_and_si128(is_g, _mm_set1_epi8(2)), _mm_and_si128(is_t, _mm_set1_epi8(3))));
+        // merge neighbours, the earlier (lower address, less significant) one moving to the more significant bits:
+        // 2 codes per 16 bits, 4 per 32 bits, 8 per 64 bits
+        codes = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(codes, 2), _mm_set1_epi16(0x00FF)), _mm_srli_epi16(codes, 8));
+        codes = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(codes, 4), _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(codes, 16));
+        codes = _mm_or_si128(_mm_and_si128(_mm_slli_epi64(codes, 8), _mm_set1_epi64x(0xFFFFFFFF)), _mm_srli_epi64(codes, 32));
+        const uint64_t low = uint64_t(_mm_cvtsi128_si64(codes));                     // characters 0..7: 16 bits
+        const uint64_t high = uint64_t(_mm_cvtsi128_si64(_mm_srli_si128(codes, 8))); // characters 8..15
+        result = (result << 32) | (low << 16) | high;
+    }
+    return result;
+#else
+    uint64_t result = 0;
+    for (int i = 0; i < 32; i++) {
+        const char c = text[i];
+        if (!sameBase(c, c)) exact = false;
+        result = (result << 2) | ordValue(c);
+    }
+    return result;
+#endif
+}
+
+} // namespace
+
+PackedText::PackedText(const std::string_view text) : words(text.size() / 32 + 2, 0), length(text.size()) {
+    const size_t full = text.size() / 32;
+    bool all_exact = true;
+    #pragma omp parallel for schedule(static) reduction(&&:all_exact)
+    for (size_t w = 0; w < full; w++) {
+        bool word_exact = true;
+        words[w] = packWord(text.data() + 32 * w, word_exact);
+        all_exact = all_exact && word_exact;
+    }
+    // the last partial word
+    uint64_t last = 0;
+    for (size_t i = 32 * full; i < text.size(); i++) {
+        const char c = text[i];
+        if (!sameBase(c, c)) all_exact = false;
+        last |= uint64_t(ordValue(c)) << (62 - 2 * (i % 32));
+    }
+    words[full] = last;
+    exact = all_exact;
+}
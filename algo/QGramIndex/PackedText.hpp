@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+   A DNA text packed to 2 bits per base (see ordValue()), 32 bases per 64-bit word, the first base in the most
+   significant bits, i.e. the bits of q consecutive bases are exactly their q-gram hash (see RollingHash).
+
+   Any q-gram hash (q <= 32) is extracted in O(1) from two words, independent of the previous position, and
+   two sequences are compared 32 bases per word. Packing translates 16 characters per SSE2 instruction
+   (scalar fallback without SSE2) and runs in parallel with OpenMP.
+
+   Characters other than ACGTU map to A, like ordValue(); isExact() tells whether the text consisted of ACGT only
+   (either case), i.e. whether comparisons on the packed text are exact (see sameBase()).
+*/
+class PackedText
+{
+public:
+    PackedText() = default;
+
+    /// Pack @p text
+    explicit PackedText(std::string_view text);
+
+    /// Number of bases
+    size_t size() const { return length; }
+
+    bool empty() const { return length == 0; }
+
+    /// Whether the text consisted of the characters ACGT only (either case), i.e. unpacking gives it back up to case
+    bool isExact() const { return exact; }
+
+    /// The 32 bases starting at @p pos (beyond the end: A), first base in the most significant bits
+    uint64_t word(const size_t pos) const {
+        const size_t w = pos / 32;
+        const unsigned shift = 2 * (pos % 32);
+        // (x >> 1) >> (63 - shift) avoids the undefined shift by 64 for shift = 0
+        return (words[w] << shift) | ((words[w + 1] >> 1) >> (63 - shift));
+    }
+
+    /// Hash of the @p q bases (1 to 32) starting at @p pos, as RollingHash::hash()
+    uint64_t hash(const size_t pos, const unsigned q) const {
+        return word(pos) >> (64 - 2*q);
+    }
+
+    /// Base at @p pos as 2-bit value
+    unsigned operator[](const size_t pos) const {
+        return (words[pos / 32] >> (62 - 2 * (pos % 32))) & 3;
+    }
+
+    /// Whether @p pattern occurs at @p pos, comparing 32 bases at a time
+    bool matches(const size_t pos, const PackedText& pattern) const {
+        const size_t m = pattern.size();
+        if (pos + m > length) return false;
+        size_t i = 0;
+        for (; i + 32 <= m; i += 32) {
+            if (word(pos + i) != pattern.words[i / 32]) return false;
+        }
+        if (i == m) return true;
+        const unsigned rest = 2 * (m - i);
+        return (word(pos + i) ^ pattern.words[i / 32]) >> (64 - rest) == 0;
+    }
+
+    /// Memory of the packed text in bytes
+    size_t bytes() const { return words.size() * sizeof(uint64_t); }
+
+private:
+    std::vector<uint64_t> words; ///< plus one zero word at the end, so that word() may always read two words
+    size_t length = 0;
+    bool exact = true;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include "qg_util.hpp"
+
+/**
+   Rolling 2-bit hash of q-grams over the DNA alphabet, for q up to 32.
+
+   The first character of a q-gram ends up in the most significant bits, i.e. the hash order is
+   the lexicographical order of the q-grams (A < C < G < T).
+*/
+class RollingHash
+{
+public:
+    /// @param q Length of q-grams (1 to 32; not checked)
+    explicit RollingHash(const uint8_t q) : q_length(q), max_hash(q >= 32 ? ~uint64_t(0) : (uint64_t(1) << 2*q) - 1) {}
+
+    /// Full hash of the q characters starting at @p qgram
+    uint64_t hash(const char* qgram) const {
+        uint64_t h = 0;
+        for (uint8_t i = 0; i < q_length; i++) h = (h << 2) | ordValue(qgram[i]);
+        return h;
+    }
+
+    /// Hash of the next q-gram: the first character of @p prev_hash drops out, @p new_pos is appended
+    uint64_t next(const uint64_t prev_hash, const char new_pos) const {
+        return ((prev_hash << 2) | ordValue(new_pos)) & max_hash;
+    }
+
+    /// Full hash of the reverse complement of the q characters starting at @p qgram
+    uint64_t hashRC(const char* qgram) const {
+        uint64_t h = 0;
+        for (uint8_t i = q_length; i > 0; i--) h = (h << 2) | (3 - ordValue(qgram[i - 1]));
+        return h;
+    }
+
+    /// Reverse complement hash of the next q-gram: the complement of @p new_pos enters at the front (most significant)
+    uint64_t nextRC(const uint64_t prev_rc, const char new_pos) const {
+        return (prev_rc >> 2) | (uint64_t(3 - ordValue(new_pos)) << (2*q_length - 2));
+    }
+
+    /// Hash of the reverse complement of the q-gram with hash @p h (complement and reverse the 2-bit groups)
+    uint64_t reverseComplement(const uint64_t h) const {
+        uint64_t x = ~h;
+        x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+        x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+        x = (x >> 32) | (x << 32);
+        return x >> (64 - 2*q_length);
+    }
+
+    /// Largest valid hash, i.e. 4^q - 1 (the hash of TTT...T)
+    uint64_t maxHash() const { return max_hash; }
+
+    uint8_t getQ() const { return q_length; }
+
+private:
+    uint8_t q_length;
+    uint64_t max_hash;
+};
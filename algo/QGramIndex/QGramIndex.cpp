@@ -1,12 +1,70 @@
 #include "QGramIndex.hpp"
 #include <iostream>
 #include "qg_util.hpp"
+#include "Minimizer.hpp"
+#include "qg_fasta.hpp"
 // #include <bitset> // DEBUG
-#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// Hint the CPU to load @p address into the cache (no-op on compilers without the builtin)
+inline void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+} // namespace
+
+/// The output file of buildFile() while the index is built: the text section is mapped read-only, the suffix array
+/// (behind it, at a page boundary) read-write
+struct QGramIndex::IndexWriter {
+    std::string filename;
+    int fd = -1;
+    const char* text = nullptr;  ///< mapping of the file up to the end of the text section
+    size_t text_bytes = 0;
+    uint64_t sa_offset = 0;      ///< start of the suffix array section
+    uint32_t* sa = nullptr;      ///< mapping of the suffix array section
+    size_t sa_bytes = 0;
+
+    /// Grow the file by the suffix array section (@p n entries) and map it
+    uint32_t* mapSuffixArray(const size_t n) {
+        sa_bytes = n * sizeof(uint32_t);
+        if (ftruncate(fd, sa_offset + sa_bytes) != 0) throw std::runtime_error("Cannot write index file '" + filename + "'!");
+        if (n == 0) return nullptr;
+        void* addr = mmap(nullptr, sa_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, sa_offset);
+        if (addr == MAP_FAILED) throw std::runtime_error("Cannot map index file '" + filename + "'!");
+        sa = static_cast<uint32_t*>(addr);
+        return sa;
+    }
+
+    ~IndexWriter() {
+        if (sa) munmap(sa, sa_bytes);
+        if (text) munmap(const_cast<char*>(text), text_bytes);
+        if (fd >= 0) close(fd);
+    }
+};
 
 
 uint32_t QGramIndex::hash(const std::string& qgram) const {
-    if (qgram.size() != q_length) throw std::invalid_argument("Invalid q-gram. Wrong length!");
+    if (qgram.size() != seed.span()) throw std::invalid_argument("Invalid q-gram. Wrong length!");
+    if (q_length > 16) throw std::invalid_argument("Invalid q-gram. Use hash64() for q > 16!");
+    if (!seed.isContiguous()) return seed.hash(qgram.data());
     uint32_t hash_value = 0;
 
     for (const auto& i : qgram) {
@@ -27,74 +85,912 @@ uint32_t QGramIndex::hashNext(const uint32_t prev_hash, const char new_pos) cons
     return hash_value & ~mask;
 }
 
-QGramIndex::QGramIndex(const std::string& text, const uint8_t q) :  q_length(q), search_text(text) {
-    if (q_length < 1 || q_length > 13) throw std::invalid_argument("Invalid q!");
+uint64_t QGramIndex::hash64(const std::string& qgram) const {
+    if (qgram.size() != seed.span()) throw std::invalid_argument("Invalid q-gram. Wrong length!");
+    return seed.hash(qgram.data());
+}
+
+uint64_t QGramIndex::hashNext64(const uint64_t prev_hash, const char new_pos) const {
+    return rolling.next(prev_hash, new_pos);
+}
+
+QGramIndex::QGramIndex(const std::string& text, const uint8_t q) : QGramIndex(text, q, QGramOptions{}) {
+}
+
+QGramIndex::QGramIndex(const std::string& text, const uint8_t q, const QGramOptions& options)
+    : QGramIndex(text, std::vector<uint32_t>{}, q, options) {
+}
+
+QGramIndex::QGramIndex(const std::string& text, const std::vector<uint32_t>& record_starts, const uint8_t q,
+                       const QGramOptions& options)
+    : QGramIndex(std::string_view(text), record_starts, q, options, nullptr) {
+    text_string = &text;
+}
+
+QGramIndex::QGramIndex(const std::string_view text, const std::vector<uint32_t>& record_starts, const uint8_t q,
+                       const QGramOptions& options, IndexWriter* writer)
+    : q_length(q), sparse(options.sparse), window(options.window), canonical(options.canonical), rolling(q),
+      seed(options.seed_mask.empty() ? SpacedSeed(q) : SpacedSeed(options.seed_mask)), text_string(nullptr), search_text(text.data()) {
+    if (q_length < 1 || q_length > (sparse ? 32 : 13)) throw std::invalid_argument("Invalid q!");
+    if (seed.weight() != q_length || (!seed.isContiguous() && (window > 1 || canonical)))
+        throw std::invalid_argument("Invalid seed mask!");
+
+    search_text_length = text.length();
+    mask = ~uint32_t(rolling.maxHash()); // Our bit mask for our hash function (0 for q >= 16)
+    if (canonical && search_text_length >= STRAND_BIT) throw std::invalid_argument("Text too long for canonical q-grams (2^31)!");
+
+    if (record_starts.empty()) record_storage.assign(1, 0);
+    else record_storage = record_starts;
+    if (record_storage[0] != 0 || !std::is_sorted(record_storage.begin(), record_storage.end())
+        || record_storage.back() > search_text_length) throw std::invalid_argument("Invalid record starts!");
+    records = ArrayView<uint32_t>(record_storage.data(), record_storage.size());
+
+    packed = PackedText(std::string_view(search_text, search_text_length));
+    if (!sparse) {
+        build(2*q_length, writer);
+    } else {
+        // Partition by the leading bits of the hash first (about 64 positions per partition), then sort each partition
+        const size_t positions = (search_text_length >= seed.span()) ? search_text_length - seed.span() + 1 : 0;
+        const size_t samples = (window > 1) ? positions * 2 / (window + 1) : positions;
+        uint8_t bits = 1;
+        while (bits < 2*q_length && bits < 26 && (size_t(64) << (bits + 1)) <= samples) bits++;
+        buildSparse(build(bits, writer));
+    }
+    if (!packed.isExact()) packed = PackedText(); // no exact verification on the packed text
+    setViews();
+}
+
+void QGramIndex::setViews() {
+    dir = ArrayView<uint32_t>(dir_storage.data(), dir_storage.size());
+    keys = ArrayView<uint64_t>(key_storage.data(), key_storage.size());
+    radix = ArrayView<uint32_t>(radix_storage.data(), radix_storage.size());
+    records = ArrayView<uint32_t>(record_storage.data(), record_storage.size());
+}
+
+QGramIndex QGramIndex::merge(const std::string& text, const QGramIndex& first, const QGramIndex& second) {
+    if (first.q_length != second.q_length || first.window != second.window
+        || first.canonical != second.canonical || first.seed.getMask() != second.seed.getMask()) throw std::invalid_argument("Indexes differ in q or options!");
+    const size_t length = first.search_text_length + second.search_text_length;
+    if (text.size() != length || first.getTextView() != std::string_view(text).substr(0, first.search_text_length)
+        || second.getTextView() != std::string_view(text).substr(first.search_text_length))
+        throw std::invalid_argument("Text is not the concatenation of both indexed texts!");
+    if (length > std::numeric_limits<uint32_t>::max() || (first.canonical && length >= STRAND_BIT))
+        throw std::invalid_argument("Merged text too long!");
+    return QGramIndex(text, first, second);
+}
+
+QGramIndex::QGramIndex(const std::string& text, const QGramIndex& first, const QGramIndex& second)
+    : q_length(first.q_length), sparse(first.sparse && second.sparse), window(first.window), canonical(first.canonical), rolling(q_length), seed(first.seed),
+      mask(first.mask), text_string(&text), search_text(text.data()), search_text_length(text.size()) {
+    // positions of the second part move behind the first one (for canonical entries, the strand bit is not touched:
+    // positions stay below 2^31)
+    const uint32_t offset = first.search_text_length;
+    record_storage.assign(first.records.begin(), first.records.end());
+    for (const uint32_t start : second.records) record_storage.push_back(start + offset);
+
+    // every bucket: the hits of the second part first, since a bucket lists its positions in decreasing order
+    sa_storage.resize(first.suffix_array.size() + second.suffix_array.size());
+    suffix_array = ArrayView<uint32_t>(sa_storage.data(), sa_storage.size());
+    uint32_t* out = sa_storage.data();
+    const auto append = [&out, offset, &first, &second](const std::pair<uint32_t, uint32_t> a, const std::pair<uint32_t, uint32_t> b) {
+        for (uint32_t i = b.first; i < b.second; i++) *out++ = second.suffix_array[i] + offset;
+        out = std::copy(first.suffix_array.begin() + a.first, first.suffix_array.begin() + a.second, out);
+    };
+    if (!sparse) {
+        // a sparse part is walked key by key alongside (its keys are sorted); keys, not range(): a canonical
+        // directory has empty buckets for the non-canonical hashes
+        size_t first_key = 0, second_key = 0;
+        const auto bucket = [](const QGramIndex& index, const uint64_t h, size_t& key) -> std::pair<uint32_t, uint32_t> {
+            if (!index.sparse) return index.keyRange(h);
+            if (key == index.keys.size() || index.keys[key] != h) return {0, 0};
+            key++;
+            return {index.dir[key - 1], index.dir[key]};
+        };
+        dir_storage.resize(rolling.maxHash() + 1);
+        for (uint64_t h = 0; h < dir_storage.size(); h++) {
+            dir_storage[h] = out - sa_storage.data();
+            append(bucket(first, h, first_key), bucket(second, h, second_key));
+        }
+    } else {
+        // union of both sorted key lists
+        key_storage.reserve(std::max(first.keys.size(), second.keys.size()));
+        size_t i = 0, j = 0;
+        while (i < first.keys.size() || j < second.keys.size()) {
+            const uint64_t key = (j == second.keys.size() || (i < first.keys.size() && first.keys[i] < second.keys[j]))
+                                 ? first.keys[i] : second.keys[j];
+            const bool in_first = i < first.keys.size() && first.keys[i] == key;
+            const bool in_second = j < second.keys.size() && second.keys[j] == key;
+            key_storage.push_back(key);
+            dir_storage.push_back(out - sa_storage.data());
+            append(in_first ? std::make_pair(first.dir[i], first.dir[i+1]) : std::make_pair(0u, 0u),
+                   in_second ? std::make_pair(second.dir[j], second.dir[j+1]) : std::make_pair(0u, 0u));
+            i += in_first;
+            j += in_second;
+        }
+        dir_storage.push_back(sa_storage.size());
+        buildRadix();
+    }
+    packed = PackedText(text);
+    if (!packed.isExact()) packed = PackedText();
+    setViews();
+}
+
+uint64_t QGramIndex::keyAt(const uint32_t entry) const {
+    const uint64_t h = seed.extract(packed.hash(entry & ~STRAND_BIT, seed.span()));
+    if (!canonical) return h;
+    return std::min(h, rolling.reverseComplement(h));
+}
+
+size_t QGramIndex::recordEnd(const size_t r) const {
+    return (r + 1 < records.size()) ? records[r+1] : search_text_length;
+}
+
+size_t QGramIndex::countQGrams() const {
+    size_t count = 0;
+    for (size_t r = 0; r < records.size(); r++) {
+        const size_t length = recordEnd(r) - records[r];
+        if (length >= seed.span()) count += length - seed.span() + 1;
+    }
+    return count;
+}
+
+template <typename Visit>
+void QGramIndex::forEachQGram(const size_t begin, const size_t end, Visit&& visit) const {
+    // No q-gram may span two records, i.e. the rolling hash restarts at every record
+    size_t r = std::upper_bound(records.begin(), records.end(), begin) - records.begin() - 1;
+    size_t i = begin;
+    while (i < end && r < records.size()) {
+        const size_t record_end = recordEnd(r);
+        const size_t span = seed.span();
+        const size_t last = std::min(end, record_end >= span ? record_end - span + 1 : 0);
+        // every hash is read from the packed text on its own (no dependency on the previous position)
+        if (!seed.isContiguous()) {
+            for (; i < last; i++) visit(i, seed.extract(packed.hash(i, span)));
+        } else if (!canonical) {
+            for (; i < last; i++) visit(i, packed.hash(i, q_length));
+        } else {
+            // canonical: the smaller of hash and reverse complement hash is the key
+            for (; i < last; i++) {
+                const uint64_t h = packed.hash(i, q_length);
+                const uint64_t rc = rolling.reverseComplement(h);
+                visit(i | (rc < h ? STRAND_BIT : 0), std::min(h, rc));
+            }
+        }
+        i = std::max(i, record_end);
+        r++;
+    }
+}
+
+template <typename Visit>
+void QGramIndex::forEachSample(const size_t begin, const size_t end, Visit&& visit) const {
+    if (window <= 1) {
+        forEachQGram(begin, end, visit);
+        return;
+    }
+    // minimizers of every record that overlaps [begin, end); forEachMinimizer() looks beyond the range as needed
+    size_t r = std::upper_bound(records.begin(), records.end(), begin) - records.begin() - 1;
+    for (; r < records.size() && records[r] < end; r++) {
+        const size_t start = records[r];
+        forEachMinimizer(search_text + start, recordEnd(r) - start, rolling, window, canonical,
+                         std::max(begin, start) - start, end - start,
+                         [start, &visit](const size_t pos, const uint64_t h, const bool reverse) {
+                             visit((start + pos) | (reverse ? STRAND_BIT : 0), h);
+                         });
+    }
+}
+
+void QGramIndex::getMinimizers(const std::string& seq, std::vector<std::pair<uint32_t, uint64_t>>& minimizers) const {
+    minimizers.clear();
+    if (!seed.isContiguous()) {
+        for (size_t i = 0; i + seed.span() <= seq.size(); i++) minimizers.emplace_back(i, seed.hash(seq.data() + i));
+        return;
+    }
+    forEachMinimizer(seq.data(), seq.size(), rolling, std::max<uint32_t>(window, 1), canonical, 0, seq.size(),
+                     [&minimizers](const size_t pos, const uint64_t h, const bool reverse) {
+                         minimizers.emplace_back(pos | (reverse ? STRAND_BIT : 0), h);
+                     });
+}
+
+uint32_t QGramIndex::getWindow() const {
+    return window;
+}
+
+uint32_t* QGramIndex::build(const uint8_t bucket_bits, IndexWriter* writer) {
+    // Counting sort of all q-gram positions by the leading bucket_bits of their hash
+    const size_t buckets = size_t(1) << bucket_bits;
+    const uint8_t shift = 2*q_length - bucket_bits;
+    const size_t positions = (search_text_length >= seed.span()) ? search_text_length - seed.span() + 1 : 0;
+
+    // Every thread keeps its own histogram (|SIGMA|^q counters), so only use as many threads
+    // as the text can keep busy: in total, the histograms are never larger than the suffix array
+    int threads = 1;
+#ifdef _OPENMP
+    threads = std::max<int>(1, std::min<size_t>(omp_get_max_threads(), positions / buckets));
+#endif
+
+    // 1. Count occurrences per thread chunk
+    std::vector<uint32_t> histograms(threads * buckets, 0);
+    dir_storage.assign(buckets, 0);
+    std::vector<uint32_t> block_sums(threads + 1, 0);
+    uint32_t* sa = nullptr;
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        const size_t chunk_begin = positions * t / threads;
+        const size_t chunk_end = positions * (t + 1) / threads;
+        uint32_t* hist = histograms.data() + t * buckets;
+        forEachSample(chunk_begin, chunk_end, [hist, shift](const size_t, const uint64_t h) { hist[h >> shift]++; });
+
+        #pragma omp barrier
+        // 2. Total count per bucket
+        #pragma omp for schedule(static)
+        for (size_t h = 0; h < buckets; h++) {
+            uint32_t total = 0;
+            for (int u = 0; u < threads; u++) total += histograms[u * buckets + h];
+            dir_storage[h] = total;
+        }
+
+        // 3. Exclusive prefix sum over dir: sum per block, scan the block sums, then scan each block
+        const size_t block_begin = buckets * t / threads;
+        const size_t block_end = buckets * (t + 1) / threads;
+        uint32_t sum = 0;
+        for (size_t h = block_begin; h < block_end; h++) sum += dir_storage[h];
+        block_sums[t + 1] = sum;
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int u = 1; u <= threads; u++) block_sums[u] += block_sums[u - 1];
+            if (writer) {
+                sa = writer->mapSuffixArray(block_sums[threads]);
+            } else {
+                sa_storage.resize(block_sums[threads]);
+                sa = sa_storage.data();
+            }
+        }
+        uint32_t running = block_sums[t];
+        for (size_t h = block_begin; h < block_end; h++) {
+            const uint32_t count = dir_storage[h];
+            dir_storage[h] = running;
+            running += count;
+        }
+        #pragma omp barrier
+
+        // 4. Each thread gets its own window in every bucket. Higher chunks come first and every window is
+        //    filled backwards, so each bucket lists its positions in decreasing order -- for any number of threads.
+        #pragma omp for schedule(static)
+        for (size_t h = 0; h < buckets; h++) {
+            uint32_t end = dir_storage[h];
+            for (int u = threads - 1; u >= 0; u--) {
+                end += histograms[u * buckets + h];
+                histograms[u * buckets + h] = end;
+            }
+        }
+
+        // 5. Scatter the positions into the suffix array
+        forEachSample(chunk_begin, chunk_end, [sa, hist, shift](const size_t i, const uint64_t h) {
+            sa[--hist[h >> shift]] = i;
+        });
+    }
+    suffix_array = ArrayView<uint32_t>(sa, block_sums[threads]);
+    return sa;
+}
+
+void QGramIndex::buildSparse(uint32_t* sa) {
+    // dir holds the start of each partition; positions within a partition are still unsorted
+    const size_t partitions = dir_storage.size();
+    std::vector<std::vector<std::pair<uint64_t, uint32_t>>> partition_keys(partitions); // (key, start) per partition
+    std::vector<uint32_t> first_key(partitions + 1, 0);
+
+    // 1. Sort every partition by the full hash. The sort is stable, i.e. the positions of a q-gram stay in decreasing order
+    #pragma omp parallel
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> entries;
+        #pragma omp for schedule(dynamic, 64)
+        for (size_t p = 0; p < partitions; p++) {
+            const uint32_t begin = dir_storage[p];
+            const uint32_t end = (p + 1 < partitions) ? dir_storage[p+1] : suffix_array.size();
+            entries.clear();
+            for (uint32_t i = begin; i < end; i++)
+                entries.emplace_back(keyAt(sa[i]), sa[i]);
+            std::stable_sort(entries.begin(), entries.end(),
+                             [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (uint32_t i = begin; i < end; i++) {
+                const auto& e = entries[i - begin];
+                sa[i] = e.second;
+                if (i == begin || e.first != entries[i - begin - 1].first) partition_keys[p].emplace_back(e.first, i);
+            }
+            first_key[p + 1] = partition_keys[p].size();
+        }
+    }
+
+    // 2. Concatenate the keys of all partitions; dir[k] is the start of key k in the suffix array
+    for (size_t p = 0; p < partitions; p++) first_key[p + 1] += first_key[p];
+    const size_t distinct = first_key[partitions];
+    key_storage.resize(distinct);
+    dir_storage.assign(distinct + 1, suffix_array.size());
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (size_t p = 0; p < partitions; p++) {
+        for (size_t k = 0; k < partition_keys[p].size(); k++) {
+            key_storage[first_key[p] + k] = partition_keys[p][k].first;
+            dir_storage[first_key[p] + k] = partition_keys[p][k].second;
+        }
+        std::vector<std::pair<uint64_t, uint32_t>>().swap(partition_keys[p]);
+    }
+
+    buildRadix();
+}
+
+void QGramIndex::buildRadix() {
+    // Radix table over the leading bits of the keys (about one slot per key), narrows the binary search in getHits
+    const size_t distinct = key_storage.size();
+    uint8_t lookup_bits = 0;
+    while (lookup_bits < 2*q_length && (size_t(2) << lookup_bits) <= distinct) lookup_bits++;
+    lookup_shift = 2*q_length - lookup_bits;
+    radix_storage.assign((size_t(1) << lookup_bits) + 1, 0);
+    for (const uint64_t key : key_storage) radix_storage[radixOf(key) + 1]++;
+    for (size_t b = 1; b < radix_storage.size(); b++) radix_storage[b] += radix_storage[b - 1];
+}
+
+std::pair<uint32_t, uint32_t> QGramIndex::range(uint64_t h) const {
+    if (canonical) h = std::min(h, rolling.reverseComplement(h));
+    return keyRange(h);
+}
+
+std::pair<uint32_t, uint32_t> QGramIndex::keyRange(const uint64_t h) const {
+    if (!sparse) {
+        // Check if we are scanning the last q-gram (TTT...T)
+        if (h == rolling.maxHash()) return {dir[h], suffix_array.size()};
+        return {dir[h], dir[h+1]};
+    }
+    const size_t b = radixOf(h);
+    const auto first = keys.begin() + radix[b];
+    const auto last = keys.begin() + radix[b + 1];
+    const auto it = std::lower_bound(first, last, h);
+    if (it == last || *it != h) return {0, 0};
+    const size_t k = it - keys.begin();
+    return {dir[k], dir[k+1]};
+}
+
+uint32_t QGramIndex::lowerBound(const uint64_t h) const {
+    if (!sparse) return (h > rolling.maxHash()) ? suffix_array.size() : dir[h];
+    if (h > rolling.maxHash()) return suffix_array.size();
+    const size_t b = radixOf(h);
+    const auto it = std::lower_bound(keys.begin() + radix[b], keys.begin() + radix[b + 1], h);
+    return dir[it - keys.begin()];
+}
 
-    search_text_length = search_text.length();
-    mask = ~0 << 2*q_length; // Our bit mask for our hash function
+QGramIndex::Pattern::Pattern(const std::string& pattern, const bool pack) : text(pattern) {
+    if (!pack) return;
+    packed = PackedText(pattern);
+    if (!packed.isExact()) packed = PackedText(); // e.g. an N never matches, compare the characters
+}
 
-    // Initialize the q-gram
-    // Start by sorting using counting sort
-    // 1. Initializiation phase
-    for (size_t i = 0; i < std::pow(alphabet_length, q_length); i++) {
-        dir.push_back(0);
+bool QGramIndex::occursAt(const Pattern& pattern, const size_t pos) const {
+    // an occurrence must lie within one record
+    const size_t m = pattern.text.size();
+    if (pos + m > search_text_length) return false;
+    if (!pattern.packed.empty() ? !packed.matches(pos, pattern.packed)
+                                : !sameBases(search_text + pos, pattern.text.data(), m)) return false;
+    const size_t r = std::upper_bound(records.begin(), records.end(), pos) - records.begin() - 1;
+    return pos + m <= recordEnd(r);
+}
+
+void QGramIndex::findPrefix(const Pattern& pattern, const uint32_t flag, std::vector<uint32_t>& hits) const {
+    // all q-grams starting with the pattern form one range of hashes, i.e. of the suffix array
+    const size_t m = pattern.text.size();
+    const unsigned shift = 2 * (q_length - m);
+    uint64_t prefix = 0;
+    for (const char c : pattern.text) prefix = (prefix << 2) | ordValue(c);
+    const uint32_t begin = lowerBound(prefix << shift);
+    const bool last_prefix = (prefix == (uint64_t(1) << 2*m) - 1); // TT...T: (prefix + 1) << shift might overflow
+    const uint32_t end = last_prefix ? suffix_array.size() : lowerBound((prefix + 1) << shift);
+    for (uint32_t i = begin; i < end; i++) {
+        if (occursAt(pattern, suffix_array[i])) hits.push_back(suffix_array[i] | flag);
+    }
+    // plus the last q-1 positions of every record, which start no q-gram
+    for (size_t r = 0; r < records.size(); r++) {
+        const size_t record_end = recordEnd(r);
+        const size_t first = std::max<size_t>(records[r], record_end >= q_length ? record_end - q_length + 1 : 0);
+        for (size_t pos = first; pos + m <= record_end; pos++) {
+            if (occursAt(pattern, pos)) hits.push_back(pos | flag);
+        }
     }
+}
 
-    // 2. Fetch occurences
-    // We need to add the first occurence manually in order to use the rolling hash function
-    uint32_t previous_hash = hash(search_text.substr(0, q_length));
-    dir[previous_hash]++;
-    for (size_t i = 1; i < search_text_length - q_length+1; i++) {
-        uint32_t j = hashNext(previous_hash, search_text[i+q_length-1]);
-        dir[j]++;
-        previous_hash = j;
+void QGramIndex::findSeeded(const Pattern& pattern, const uint32_t flag, const Pattern* rc_pattern,
+                            std::vector<uint32_t>& hits) const {
+    // seed: the q-gram of the pattern with the fewest hits (for a minimizer index: the rarest minimizer)
+    const size_t m = pattern.text.size();
+    std::vector<std::pair<uint32_t, uint64_t>> seeds;
+    getMinimizers(pattern.text, seeds);
+    uint32_t seed = 0;
+    uint64_t seed_hash = 0;
+    std::pair<uint32_t, uint32_t> seed_range{0, ~uint32_t(0)};
+    for (const auto& [offset, h] : seeds) {
+        const auto r = range(h);
+        if (r.second - r.first < seed_range.second - seed_range.first) {
+            seed_range = r;
+            seed = offset;
+            seed_hash = h;
+        }
+    }
+    if (!canonical) {
+        for (uint32_t i = seed_range.first; i < seed_range.second; i++) {
+            const uint32_t pos = suffix_array[i];
+            if (pos >= seed && occursAt(pattern, pos - seed)) hits.push_back((pos - seed) | flag);
+        }
+        return;
+    }
+    // canonical: hits on the seed's strand are candidates for the pattern, the others for its reverse complement
+    // (the q-gram at offset o of the pattern is at offset m-q-o of the reverse complement); a palindrome fits both
+    const uint32_t seed_offset = seed & ~STRAND_BIT;
+    const bool palindrome = (seed_hash == rolling.reverseComplement(seed_hash));
+    const uint32_t rc_offset = m - q_length - seed_offset;
+    for (uint32_t i = seed_range.first; i < seed_range.second; i++) {
+        const uint32_t pos = suffix_array[i] & ~STRAND_BIT;
+        const bool same_strand = (suffix_array[i] & STRAND_BIT) == (seed & STRAND_BIT);
+        if ((same_strand || palindrome) && pos >= seed_offset && occursAt(pattern, pos - seed_offset))
+            hits.push_back((pos - seed_offset) | flag);
+        if (rc_pattern && (!same_strand || palindrome) && pos >= rc_offset && occursAt(*rc_pattern, pos - rc_offset))
+            hits.push_back((pos - rc_offset) | STRAND_BIT);
     }
+}
+
+std::vector<uint32_t> QGramIndex::find(const std::string& pattern, const bool both_strands) const {
+    if (pattern.empty()) throw std::invalid_argument("Empty pattern!");
+    if (both_strands && search_text_length >= STRAND_BIT) throw std::invalid_argument("Text too long to mark strands (2^31)!");
+    const size_t m = pattern.size();
+    // candidates are verified on the packed text if there is one (ACGT only)
+    const Pattern forward(pattern, !packed.empty());
+    const Pattern rc_pattern(both_strands ? reverseComplement(pattern) : std::string(), both_strands && !packed.empty());
+    std::vector<uint32_t> hits;
+
+    if (m < seed.span()) {
+        if (window > 1 || canonical || !seed.isContiguous())
+            throw std::invalid_argument("Pattern is shorter than q (not supported with minimizers, canonical q-grams or spaced seeds)!");
+        findPrefix(forward, 0, hits);
+        if (both_strands) findPrefix(rc_pattern, STRAND_BIT, hits);
+    } else {
+        if (window > 1 && m < size_t(q_length) + window - 1)
+            throw std::invalid_argument("Pattern is shorter than q + w - 1 (one minimizer window)!");
+        if (canonical) {
+            // one lookup serves both strands
+            findSeeded(forward, 0, both_strands ? &rc_pattern : nullptr, hits);
+        } else {
+            findSeeded(forward, 0, nullptr, hits);
+            if (both_strands) findSeeded(rc_pattern, STRAND_BIT, nullptr, hits);
+        }
+    }
+    if (both_strands) {
+        std::sort(hits.begin(), hits.end(), [](const uint32_t a, const uint32_t b) {
+            return std::make_pair(a & ~STRAND_BIT, a) < std::make_pair(b & ~STRAND_BIT, b);
+        });
+    } else {
+        std::sort(hits.begin(), hits.end());
+    }
+    return hits;
+}
+
+void QGramIndex::verifyBanded(const std::string& pattern, const uint32_t k, const int64_t diagonal_begin,
+                              const int64_t diagonal_end, const size_t r, std::vector<ApproximateMatch>& matches) const {
+    // Edit distance DP with free start and end in the text: D[i][c] = errors of pattern[0, i) against a text substring
+    // ending at c. Only cells with c - i in [diagonal_begin, diagonal_end] are computed; rows are indexed by the diagonal.
+    // Every cell carries the start column of its alignment.
+    const size_t m = pattern.size();
+    const int64_t record_begin = records[r];
+    const int64_t record_end = recordEnd(r);
+    const size_t width = diagonal_end - diagonal_begin + 1;
+    const uint32_t INF = std::numeric_limits<uint32_t>::max() / 2;
+    std::vector<uint32_t> previous(width), current(width), previous_start(width), current_start(width);
+    for (size_t x = 0; x < width; x++) {
+        const int64_t c = diagonal_begin + int64_t(x);
+        previous[x] = (c >= record_begin && c <= record_end) ? 0 : INF;
+        previous_start[x] = c;
+    }
+    for (size_t i = 1; i <= m; i++) {
+        uint32_t row_min = INF;
+        for (size_t x = 0; x < width; x++) {
+            const int64_t c = int64_t(i) + diagonal_begin + int64_t(x);
+            uint32_t best = INF, start = 0;
+            if (c >= record_begin && c <= record_end) {
+                // match/substitution (same diagonal), deletion (from the row above), insertion (from the left)
+                if (c > record_begin && previous[x] < INF) {
+                    best = previous[x] + !sameBase(pattern[i-1], search_text[c-1]);
+                    start = previous_start[x];
+                }
+                if (x + 1 < width && previous[x+1] + 1 < best) {
+                    best = previous[x+1] + 1;
+                    start = previous_start[x+1];
+                }
+                if (x > 0 && current[x-1] + 1 < best) {
+                    best = current[x-1] + 1;
+                    start = current_start[x-1];
+                }
+            }
+            current[x] = std::min(best, INF);
+            current_start[x] = start;
+            row_min = std::min(row_min, current[x]);
+        }
+        if (row_min > k) return; // row minima never decrease
+        previous.swap(current);
+        previous_start.swap(current_start);
+    }
+    for (size_t x = 0; x < width; x++) {
+        if (previous[x] <= k) matches.push_back({previous_start[x], uint32_t(int64_t(m) + diagonal_begin + int64_t(x)), previous[x]});
+    }
+}
 
-    // 3. Create cumulative sum
-    for (size_t i = 1; i < dir.size(); i++) {
-        dir[i] += dir[i-1];
+std::vector<ApproximateMatch> QGramIndex::findApproximate(const std::string& pattern, const uint32_t max_errors,
+                                                          const bool mismatches_only) const {
+    if (window > 1) throw std::invalid_argument("Approximate search is not supported with minimizers!");
+    const int64_t m = pattern.size();
+    const int64_t k = max_errors;
+    // an error breaks at most every window across it (spaced seed: a mismatch only those with a '1' at its position)
+    const int64_t span = seed.span();
+    const int64_t threshold = m - span + 1 - k * (mismatches_only ? q_length : span);
+    if (threshold < 1) throw std::invalid_argument("Pattern too short for the q-gram filter (m - q + 1 - k*q < 1)!");
+
+    // 1. Diagonals of all hits of the q-grams of the pattern (canonical: only hits on the strand of the pattern's q-gram)
+    std::vector<int64_t> diagonals;
+    uint64_t h = 0;
+    for (int64_t j = 0; j + span <= m; j++) {
+        if (!seed.isContiguous()) h = seed.hash(pattern.data() + j);
+        else h = (j == 0) ? rolling.hash(pattern.data()) : rolling.next(h, pattern[j + q_length - 1]);
+        const uint64_t rc = canonical ? rolling.reverseComplement(h) : h;
+        for (const uint32_t hit : getHitsView(h)) {
+            if (canonical && rc != h && isReverse(hit) != (rc < h)) continue;
+            diagonals.push_back(int64_t(hitPosition(hit)) - j);
+        }
     }
+    std::sort(diagonals.begin(), diagonals.end());
 
-    // 3.5 Initialize suffix array
-    // The cumulated sum from dir (last position in dir) is the size of our suffix array
-    for (size_t i = 0; i < dir[dir.size()-1]; i++) {
-        suffix_array.push_back(0);
+    // 2. Windows of k+1 diagonals (mismatches: one diagonal) holding at least threshold hits, merged into regions
+    //    whose verification bands overlap
+    const int64_t window_width = mismatches_only ? 0 : k;
+    const int64_t merge_gap = mismatches_only ? 0 : 4*k + 1;
+    std::vector<std::pair<int64_t, int64_t>> regions; // [first, last] diagonal
+    for (size_t i = 0, end = 0; i < diagonals.size(); i++) {
+        while (end < diagonals.size() && diagonals[end] <= diagonals[i] + window_width) end++;
+        if (int64_t(end - i) < threshold) continue;
+        if (!regions.empty() && diagonals[i] <= regions.back().second + merge_gap)
+            regions.back().second = std::max(regions.back().second, diagonals[end - 1]);
+        else
+            regions.emplace_back(diagonals[i], diagonals[end - 1]);
     }
 
-    // 4. Use dir to create our suffix array
-    // Here we need to use our hash function in the same manner as in step 2
-    previous_hash = hash(search_text.substr(0, q_length));
-    dir[previous_hash]--;
-    suffix_array[dir[previous_hash]] = 0;
-    for (size_t i = 1; i < search_text_length - q_length+1; i++) {
-        uint32_t j = hashNext(previous_hash, search_text[i+q_length-1]);
-        dir[j]--;
-        suffix_array[dir[j]] = i;
-        previous_hash = j;
+    // 3. Verify every region within each record it overlaps
+    std::vector<ApproximateMatch> matches;
+    const int64_t n = search_text_length;
+    for (const auto& [first, last] : regions) {
+        if (mismatches_only) {
+            for (int64_t d = std::max<int64_t>(first, 0); d <= last && d + m <= n; d++) {
+                const size_t r = std::upper_bound(records.begin(), records.end(), d) - records.begin() - 1;
+                if (d + m > int64_t(recordEnd(r))) continue;
+                uint32_t mismatches = 0;
+                for (int64_t i = 0; i < m && mismatches <= max_errors; i++) mismatches += !sameBase(pattern[i], search_text[d + i]);
+                if (mismatches <= max_errors) matches.push_back({uint32_t(d), uint32_t(d + m), mismatches});
+            }
+            continue;
+        }
+        // an occurrence starting at s has all its q-gram hits on diagonals within [s-k, s+k], and its alignment
+        // stays within the same range of diagonals: [first - 2k, last + 2k] covers all of them
+        const int64_t band_begin = first - 2*k;
+        const int64_t band_end = last + 2*k;
+        const int64_t span_begin = std::max<int64_t>(band_begin, 0);
+        const int64_t span_end = std::min<int64_t>(band_end + m, n);
+        size_t r = std::upper_bound(records.begin(), records.end(), span_begin) - records.begin() - 1;
+        for (; r < records.size() && int64_t(records[r]) <= span_end; r++) verifyBanded(pattern, max_errors, band_begin, band_end, r, matches);
     }
+
+    // 4. One match per end: the one with the fewest errors
+    std::sort(matches.begin(), matches.end(), [](const ApproximateMatch& a, const ApproximateMatch& b) {
+        return std::make_pair(a.end, a.errors) < std::make_pair(b.end, b.errors);
+    });
+    matches.erase(std::unique(matches.begin(), matches.end(),
+                              [](const ApproximateMatch& a, const ApproximateMatch& b) { return a.end == b.end; }),
+                  matches.end());
+    return matches;
 }
 
 std::vector<uint32_t> QGramIndex::getHits(const uint32_t h) const {
-    if (h > std::pow(alphabet_length, q_length) - 1) throw(std::invalid_argument("Invalid hash!"));
+    if (h > ~mask) throw(std::invalid_argument("Invalid hash!"));
+    return getHits64(h);
+}
+
+std::vector<uint32_t> QGramIndex::getHits64(const uint64_t h) const {
+    if (h > rolling.maxHash()) throw(std::invalid_argument("Invalid hash!"));
+    const auto [begin, end] = range(h);
+    return std::vector<uint32_t>(suffix_array.begin() + begin, suffix_array.begin() + end);
+}
 
-    std::vector<uint32_t> output{};
-    uint32_t num_occurences;
+ArrayView<uint32_t> QGramIndex::getHitsView(const uint64_t h) const {
+    if (h > rolling.maxHash()) throw(std::invalid_argument("Invalid hash!"));
+    const auto [begin, end] = range(h);
+    return ArrayView<uint32_t>(suffix_array.data() + begin, end - begin);
+}
 
-    // Check if we are scanning the last q-gram (TTT...T)
-    // ~mask is equivalent to the hash of the last q-gram
-    if (h == ~mask) num_occurences = search_text_length - dir[h] - q_length + 1;
-    else num_occurences = dir[h+1] - dir[h];
+void QGramIndex::getHitsBatch(const std::vector<uint64_t>& hashes, std::vector<ArrayView<uint32_t>>& hits) const {
+    // Lookups of random hashes are cache misses twice over: the directory entry, then the bucket.
+    // Prefetch the directory entry DISTANCE lookups ahead, and each bucket as soon as its range is known.
+    const size_t DISTANCE = 16;
+    for (const uint64_t h : hashes) {
+        if (h > rolling.maxHash()) throw(std::invalid_argument("Invalid hash!"));
+    }
+    hits.resize(hashes.size());
+    for (size_t i = 0; i < hashes.size(); i++) {
+        if (i + DISTANCE < hashes.size()) {
+            const uint64_t ahead = hashes[i + DISTANCE];
+            prefetch(sparse ? static_cast<const void*>(&radix[radixOf(ahead)]) : static_cast<const void*>(&dir[ahead]));
+        }
+        const auto [begin, end] = range(hashes[i]);
+        hits[i] = ArrayView<uint32_t>(suffix_array.data() + begin, end - begin);
+        if (begin != end) prefetch(suffix_array.data() + begin);
+    }
+}
 
-    for (uint32_t i = 0; i < num_occurences; i++)
-        output.push_back(suffix_array[dir[h]+i]);
+bool QGramIndex::isSparse() const {
+    return sparse;
+}
 
-    return output;
+bool QGramIndex::isCanonical() const {
+    return canonical;
+}
+
+size_t QGramIndex::sizeInBytes() const {
+    return suffix_array.size() * sizeof(uint32_t) + dir.size() * sizeof(uint32_t) + keys.size() * sizeof(uint64_t)
+         + radix.size() * sizeof(uint32_t) + records.size() * sizeof(uint32_t) + (packed.empty() ? 0 : packed.bytes());
+}
+
+size_t QGramIndex::distinctQGrams() const {
+    if (sparse) return keys.size();
+    size_t distinct = 0;
+    for (uint64_t h = 0; h <= rolling.maxHash(); h++) {
+        const uint32_t end = (h == rolling.maxHash()) ? suffix_array.size() : dir[h+1];
+        distinct += (end != dir[h]);
+    }
+    return distinct;
 }
 
 uint8_t QGramIndex::getQ() const {
     return q_length;
 }
 
+size_t QGramIndex::getRecordCount() const {
+    return records.size();
+}
+
+std::pair<uint32_t, uint32_t> QGramIndex::resolve(const uint32_t pos) const {
+    if (pos >= search_text_length) throw std::invalid_argument("Invalid position!");
+    const size_t r = std::upper_bound(records.begin(), records.end(), pos) - records.begin() - 1;
+    return {uint32_t(r), pos - records[r]};
+}
+
+namespace {
+
+const char MAGIC[8] = {'Q', 'G', 'R', 'A', 'M', 'I', 'D', 'X'};
+const uint32_t FILE_VERSION = 3; // 2: record table, 3: seed mask
+const uint32_t BYTE_ORDER_MARK = 0x01020304; // written natively; reads back differently on a machine with other endianness
+
+enum Section { TEXT, SUFFIX_ARRAY, DIR, KEYS, RADIX, RECORDS, SECTIONS };
+
+/// Fixed-size header at the start of an index file; every section starts at a multiple of 64 bytes
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t q;
+    uint32_t flags;          // bit 0: sparse, bit 1: canonical
+    uint32_t lookup_shift;
+    uint32_t window;         // minimizer window (<= 1: all q-grams)
+    char seed_mask[32];      // spaced seed (zero padded; empty: contiguous q-grams)
+    uint64_t text_length;
+    uint64_t offset[SECTIONS]; // in bytes from the start of the file
+    uint64_t count[SECTIONS];  // number of elements
+};
+
+const uint64_t ALIGNMENT = 64;
+
+uint64_t alignUp(const uint64_t x) {
+    return (x + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+/// The seed stored in @p header (contiguous if there is none, or if it is invalid: load() rejects the file then)
+SpacedSeed seedOf(const FileHeader& header) {
+    const std::string mask(header.seed_mask, strnlen(header.seed_mask, sizeof(header.seed_mask)));
+    return SpacedSeed::isValid(mask) ? SpacedSeed(mask) : SpacedSeed(header.q);
+}
+
+} // namespace
+
+/// A read-only memory-mapped index file
+struct QGramIndex::Mapping {
+    const char* data = nullptr;
+    size_t length = 0;
+    std::once_flag text_once;
+    std::string text; // copy of the text for getText()
+
+    ~Mapping() {
+        if (data) munmap(const_cast<char*>(data), length);
+    }
+};
+
 const std::string& QGramIndex::getText() const {
-    return search_text;
+    if (text_string) return *text_string;
+    // loaded index: copy the text out of the mapping once
+    std::call_once(mapping->text_once, [this]() { mapping->text.assign(search_text, search_text_length); });
+    return mapping->text;
+}
+
+std::string_view QGramIndex::getTextView() const {
+    return std::string_view(search_text, search_text_length);
+}
+
+QGramIndex::QGramIndex(QGramIndex&&) = default;
+
+QGramIndex::~QGramIndex() = default;
+
+void QGramIndex::save(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot write index file '" + filename + "'!");
+    writeFile(out, alignUp(alignUp(sizeof(FileHeader)) + search_text_length), false);
+    if (!out.flush()) throw std::runtime_error("Cannot write index file '" + filename + "'!");
+}
+
+void QGramIndex::writeFile(std::ostream& out, const uint64_t sa_offset, const bool tables_only) const {
+    FileHeader header{};
+    std::copy(MAGIC, MAGIC + 8, header.magic);
+    header.version = FILE_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.q = q_length;
+    header.flags = (sparse ? 1 : 0) | (canonical ? 2 : 0);
+    header.lookup_shift = lookup_shift;
+    header.window = window;
+    if (!seed.isContiguous()) std::copy(seed.getMask().begin(), seed.getMask().end(), header.seed_mask);
+    header.text_length = search_text_length;
+
+    const char* data[SECTIONS] = {search_text, reinterpret_cast<const char*>(suffix_array.data()),
+                                  reinterpret_cast<const char*>(dir.data()), reinterpret_cast<const char*>(keys.data()),
+                                  reinterpret_cast<const char*>(radix.data()),
+                                  reinterpret_cast<const char*>(records.data())};
+    const uint64_t element_size[SECTIONS] = {1, 4, 4, 8, 4, 4};
+    header.count[TEXT] = search_text_length;
+    header.count[SUFFIX_ARRAY] = suffix_array.size();
+    header.count[DIR] = dir.size();
+    header.count[KEYS] = keys.size();
+    header.count[RADIX] = radix.size();
+    header.count[RECORDS] = records.size();
+    header.offset[TEXT] = alignUp(sizeof(FileHeader));
+    uint64_t offset = sa_offset;
+    for (int s = SUFFIX_ARRAY; s < SECTIONS; s++) {
+        header.offset[s] = offset;
+        offset = alignUp(offset + header.count[s] * element_size[s]);
+    }
+
+    const char padding[ALIGNMENT] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t written = sizeof(header);
+    for (int s = 0; s < SECTIONS; s++) {
+        const uint64_t end = header.offset[s] + header.count[s] * element_size[s];
+        if (tables_only && s <= SUFFIX_ARRAY) {
+            out.seekp(end);
+        } else {
+            out.write(padding, header.offset[s] - written);
+            out.write(data[s], header.count[s] * element_size[s]);
+        }
+        written = end;
+    }
+    out.write(padding, offset - written);
+}
+
+QGramIndex QGramIndex::load(const std::string& filename) {
+    auto mapping = std::make_unique<Mapping>();
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open index file '" + filename + "'!");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FileHeader)) {
+        close(fd);
+        throw std::runtime_error("Invalid index file '" + filename + "'!");
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (addr == MAP_FAILED) throw std::runtime_error("Cannot map index file '" + filename + "'!");
+    mapping->data = static_cast<const char*>(addr);
+    mapping->length = st.st_size;
+    return QGramIndex(std::move(mapping), filename);
+}
+
+QGramIndex QGramIndex::buildFile(std::istream& input, const std::string& filename, const uint8_t q,
+                                 const QGramOptions& options, std::vector<std::string>* names) {
+    if (q < 1 || q > (options.sparse ? 32 : 13)) throw std::invalid_argument("Invalid q!");
+    const uint64_t limit = options.canonical ? STRAND_BIT - 1 : std::numeric_limits<uint32_t>::max();
+    const uint64_t text_offset = alignUp(sizeof(FileHeader));
+    std::vector<uint32_t> starts;
+    uint64_t length = 0;
+    {
+        // 1. Stream the records into the text section (the header is written last)
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("Cannot write index file '" + filename + "'!");
+        out.seekp(text_offset);
+        forEachFastaLine(input, "sequence",
+                         [&](const std::string& name) {
+                             starts.push_back(length);
+                             if (names) names->push_back(name);
+                         },
+                         [&](const std::string& line) {
+                             if (length + line.size() > limit)
+                                 throw std::runtime_error("Input exceeds 2^32 bases (canonical: 2^31)!");
+                             out.write(line.data(), line.size());
+                             length += line.size();
+                         });
+        if (!out.flush()) throw std::runtime_error("Cannot write index file '" + filename + "'!");
+    }
+    {
+        // 2. Map the text and build: counting and scattering read the text, the suffix array is mapped from the file
+        IndexWriter writer;
+        writer.filename = filename;
+        writer.fd = open(filename.c_str(), O_RDWR);
+        if (writer.fd < 0) throw std::runtime_error("Cannot write index file '" + filename + "'!");
+        writer.text_bytes = text_offset + length;
+        void* addr = mmap(nullptr, writer.text_bytes, PROT_READ, MAP_SHARED, writer.fd, 0);
+        if (addr == MAP_FAILED) throw std::runtime_error("Cannot map index file '" + filename + "'!");
+        writer.text = static_cast<const char*>(addr);
+        const uint64_t page = sysconf(_SC_PAGESIZE);
+        writer.sa_offset = (writer.text_bytes + page - 1) / page * page; // mmap() needs a page aligned offset
+        const QGramIndex index(std::string_view(writer.text + text_offset, length), starts, q, options, &writer);
+
+        // 3. The remaining tables behind the suffix array, then the header
+        std::ofstream out(filename, std::ios::binary | std::ios::in | std::ios::out);
+        if (!out) throw std::runtime_error("Cannot write index file '" + filename + "'!");
+        index.writeFile(out, writer.sa_offset, true);
+        if (!out.flush()) throw std::runtime_error("Cannot write index file '" + filename + "'!");
+    }
+    return load(filename);
+}
+
+QGramIndex::QGramIndex(std::unique_ptr<Mapping> file, const std::string& filename)
+    : q_length(reinterpret_cast<const FileHeader*>(file->data)->q),
+      sparse(reinterpret_cast<const FileHeader*>(file->data)->flags & 1),
+      window(reinterpret_cast<const FileHeader*>(file->data)->window),
+      canonical(reinterpret_cast<const FileHeader*>(file->data)->flags & 2),
+      rolling(q_length), seed(seedOf(*reinterpret_cast<const FileHeader*>(file->data))), text_string(nullptr), mapping(std::move(file)) {
+    const FileHeader& header = *reinterpret_cast<const FileHeader*>(mapping->data);
+    const auto invalid = [&filename](const std::string& why) {
+        return std::runtime_error("Invalid index file '" + filename + "': " + why);
+    };
+    if (!std::equal(MAGIC, MAGIC + 8, header.magic)) throw invalid("not a q-gram index");
+    if (header.byte_order != BYTE_ORDER_MARK) throw invalid("written on a machine with different byte order");
+    if (header.version != FILE_VERSION) throw invalid("unsupported version " + std::to_string(header.version));
+    if (q_length < 1 || q_length > (sparse ? 32 : 13)) throw invalid("bad q");
+    if (seed.weight() != q_length || (header.seed_mask[0] != '\0' && seed.isContiguous())) throw invalid("bad seed mask");
+    if (canonical && header.text_length >= STRAND_BIT) throw invalid("text too long for canonical q-grams");
+
+    const uint64_t element_size[SECTIONS] = {1, 4, 4, 8, 4, 4};
+    for (int s = 0; s < SECTIONS; s++) {
+        if (header.offset[s] % ALIGNMENT != 0 || header.offset[s] > mapping->length
+            || header.count[s] > (mapping->length - header.offset[s]) / element_size[s]) throw invalid("truncated");
+    }
+    search_text_length = header.text_length;
+    const char* base = mapping->data;
+    records = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(base + header.offset[RECORDS]), header.count[RECORDS]);
+    if (records.empty() || records[0] != 0 || !std::is_sorted(records.begin(), records.end())
+        || records[records.size() - 1] > search_text_length) throw invalid("bad record table");
+    const bool consistent = header.count[TEXT] == search_text_length && (window <= 1 ? header.count[SUFFIX_ARRAY] == countQGrams()
+                                                                                       : header.count[SUFFIX_ARRAY] <= countQGrams())
+        && (sparse ? header.count[DIR] == header.count[KEYS] + 1 && header.lookup_shift <= 2u*q_length
+                      && 2u*q_length - header.lookup_shift <= 40
+                      && header.count[RADIX] == (size_t(1) << (2*q_length - header.lookup_shift)) + 1
+                   : header.count[DIR] == (size_t(1) << 2*q_length));
+    if (!consistent) throw invalid("inconsistent sizes");
+
+    mask = ~uint32_t(rolling.maxHash());
+    lookup_shift = header.lookup_shift;
+    search_text = base + header.offset[TEXT];
+    suffix_array = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(base + header.offset[SUFFIX_ARRAY]), header.count[SUFFIX_ARRAY]);
+    dir = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(base + header.offset[DIR]), header.count[DIR]);
+    keys = ArrayView<uint64_t>(reinterpret_cast<const uint64_t*>(base + header.offset[KEYS]), header.count[KEYS]);
+    radix = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(base + header.offset[RADIX]), header.count[RADIX]);
 }
\ No newline at end of file
@@ -3,13 +3,63 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include "ArrayView.hpp"
+#include "QGramHash.hpp"
+#include "PackedText.hpp"
+#include "SpacedSeed.hpp"
+
+/// Construction options of a QGramIndex
+struct QGramOptions
+{
+  /// Use 64-bit hashes and a sparse directory (sorted distinct q-grams + radix table) instead of a dense one
+  /// with 4^q entries. Allows q up to 32; memory scales with the number of distinct q-grams in the text.
+  bool sparse = false;
+
+  /// Minimizer window w: for w > 1, only the (w,q)-minimizers are stored (per window of w consecutive q-grams,
+  /// the smallest one under minimizerOrder()), about 2/(w+1) of all positions. getHits() then only returns the
+  /// sampled positions; look up the minimizers of a query (getMinimizers()) to find its occurrences.
+  uint32_t window = 1;
+
+  /// Key every q-gram by min(hash, reverse complement hash), i.e. a q-gram and its reverse complement share one bucket.
+  /// Every suffix array entry carries the strand in its top bit (QGramIndex::STRAND_BIT: the q-gram at this position
+  /// is the reverse complement of the key), so the text must be shorter than 2^31.
+  bool canonical = false;
+
+  /// Spaced seed (see SpacedSeed), e.g. "1101101": every window of its span is keyed by the characters at the '1's
+  /// only, i.e. q must be the number of '1's (the directory has 4^q entries). Empty: contiguous q-grams.
+  /// Not combined with minimizers or canonical keys; patterns of find() need at least span characters.
+  std::string seed_mask;
+};
+
+/// An approximate occurrence of a pattern (see QGramIndex::findApproximate())
+struct ApproximateMatch
+{
+  uint32_t begin;  ///< start in the text (of one optimal alignment)
+  uint32_t end;    ///< end in the text (exclusive)
+  uint32_t errors; ///< edit distance (or number of mismatches) between pattern and text[begin, end)
+};
 
 /**
    The Q-Gram-Index implementation using Counting Sort for SA Construction
    assuming DNA alphabet (|Sigma| = 4).
    
    The text may be up to 2^32 in length, i.e. uint32_t is used internally for suffix array and q-gram index.
-   The maximal supported value for q is 13.
+   The maximal supported value for q is 13 (dense directory), or 32 with QGramOptions::sparse.
+
+   Construction runs in parallel when compiled with OpenMP: every thread counts the q-grams of its chunk
+   of the text, the bucket offsets are computed with a parallel prefix sum, and every thread scatters its
+   positions into its own window of each bucket. The result is identical for any number of threads.
+   The text is packed to 2 bits per base first (PackedText), so every q-gram hash is read straight from the
+   packed words. If the text consists of ACGT only, the packed text (n/4 bytes) is kept to verify candidates of
+   find() 32 bases at a time; otherwise it is released after construction.
+
+   An index can be saved to a binary file and loaded again via mmap (see save() and load()): loading only
+   maps the file, so it is fast and the pages are shared through the page cache by all processes using it.
    
 */
 class QGramIndex 
@@ -17,10 +67,17 @@ class QGramIndex
 public:
     // AS ALWAYS: DO NOT CHANGE THE INTERFACE!
 
+    /// Top bit of a hit: reverse strand (canonical index, see QGramOptions::canonical; and find(pattern, true))
+    static constexpr uint32_t STRAND_BIT = 0x80000000u;
+    /// Position of a hit without its strand bit (only for indices/results that carry strands)
+    static uint32_t hitPosition(const uint32_t hit) { return hit & ~STRAND_BIT; }
+    /// Whether a hit is on the reverse strand (only for indices/results that carry strands)
+    static bool isReverse(const uint32_t hit) { return hit & STRAND_BIT; }
+
     /**
      @brief Constructor: build up a q-gram index from @p text.
 
-     Internally, @p text is stored as const reference (const std::string& ), 
+     Internally, @p text is stored as const reference (const std::string& ),
      i.e. make sure the text does not go out of scope as long as the class object is used.
      
      The index is build immediately.
@@ -31,12 +88,121 @@ public:
     */
     QGramIndex(const std::string& text, const uint8_t q);
 
+    /**
+     @brief Constructor: build up a q-gram index from @p text with the given @p options.
+
+     In sparse mode, the directory only holds the distinct q-grams of the text (sorted 64-bit hashes,
+     their start in the suffix array, and a radix table over the leading hash bits for lookup).
+     Hits are in the same order as for the dense directory.
+
+     @param text The sequence (genome, ...) to be indexed
+     @param q Length of q-gram (from 1 to 13; sparse: from 1 to 32); with a spaced seed its weight
+     @param options Construction options
+     @throws std::invalid_argument("Invalid q!") if q is out of range
+     @throws std::invalid_argument("Invalid seed mask!") if options.seed_mask is invalid, does not have q '1's,
+             or is combined with minimizers or canonical keys
+    */
+    QGramIndex(const std::string& text, const uint8_t q, const QGramOptions& options);
+
+    /**
+     @brief Constructor: build up a q-gram index over several records (e.g. the contigs of an assembly),
+     concatenated into @p text.
+
+     No q-gram spans two records; use resolve() to map a hit to (record, offset).
+     See readFasta() to load a multi-record FASTA file.
+
+     @param text All records, concatenated
+     @param record_starts Start of every record in @p text (sorted, first one is 0); empty = a single record
+     @param q Length of q-gram (see above)
+     @param options Construction options
+     @throws std::invalid_argument("Invalid q!") if q is out of range
+     @throws std::invalid_argument("Invalid record starts!") if @p record_starts is not sorted, does not start with 0 or exceeds the text
+    */
+    QGramIndex(const std::string& text, const std::vector<uint32_t>& record_starts, const uint8_t q,
+               const QGramOptions& options = QGramOptions());
+
+    /// An index owns (or maps) its tables; moving is cheap, copying is not supported
+    QGramIndex(const QGramIndex&) = delete;
+    QGramIndex& operator=(const QGramIndex&) = delete;
+    QGramIndex(QGramIndex&&);
+    ~QGramIndex();
+
+    /**
+     @brief Write the index, including a copy of the text, to @p filename.
+
+     File layout (version 3, native byte order): a fixed header (magic "QGRAMIDX", version, byte order mark,
+     q, flags (sparse, canonical), radix shift, minimizer window, spaced seed mask (32 characters, zero padded; empty
+     for contiguous q-grams), text length, offset and element count of every section), followed by the sections
+     text, suffix_array, dir, keys, radix, records (each starting at a multiple of 64 bytes).
+
+     @param filename Output file (overwritten)
+     @throws std::runtime_error if the file cannot be written
+    */
+    void save(const std::string& filename) const;
+
+    /**
+     @brief Open an index written by save() by mapping it into memory (read-only).
+
+     Nothing is copied or rebuilt, i.e. opening takes milliseconds even for a genome-scale index.
+     The header is validated; the tables themselves are trusted.
+
+     @param filename Index file
+     @return The index; its text is part of the mapping (see getTextView())
+     @throws std::runtime_error if the file cannot be opened or is not a valid index (wrong magic, version, byte order, sizes)
+    */
+    static QGramIndex load(const std::string& filename);
+
+    /**
+     @brief Build the index of a (multi-)FASTA stream straight into an index file, without holding the text in memory.
+
+     The records are streamed line by line into the text section of @p filename; the text is then mapped and read
+     twice, once to count the q-grams (dir) and once to scatter their positions into the suffix array, which is
+     mapped from the file as well, i.e. paged by the kernel. Resident memory is the directory (dir, sparse: keys
+     and radix), the text packed to 2 bits per base and one line of input -- no copy of the text, no suffix array
+     on the heap. The tables equal those of an index built over readFasta() of the same input (only the suffix
+     array section starts at a page boundary of the file).
+
+     @param input FASTA stream (plain text without header: a single record, see readFasta())
+     @param filename Output index file (overwritten)
+     @param q Length of q-grams (see QGramIndex())
+     @param options Construction options
+     @param names If not nullptr, receives the name of every record
+     @return The index, opened via load()
+     @throws std::invalid_argument("Invalid q!") if q is out of range
+     @throws std::runtime_error if the file cannot be written, or the input exceeds 2^32 (canonical: 2^31) bases
+    */
+    static QGramIndex buildFile(std::istream& input, const std::string& filename, const uint8_t q,
+                                const QGramOptions& options = QGramOptions(), std::vector<std::string>* names = nullptr);
+
+    /**
+     @brief Merge the indexes of two consecutive parts of a text into the index of the whole @p text,
+     without rehashing it: every bucket of the result is the bucket of @p second (shifted) followed by that of @p first.
+
+     The result is identical to an index built from scratch over @p text with the records of both indexes.
+     Takes time linear in the size of both indexes (plus 4^q for a dense directory).
+     The directories may differ: the result is dense if either index is, e.g. a dense base with a small sparse
+     delta (see IncrementalQGramIndex).
+
+     @param text The text of @p first followed by the text of @p second (referenced like in the constructor)
+     @param first Index of the first part of @p text
+     @param second Index of the rest of @p text
+     @return The index of @p text
+     @throws std::invalid_argument if the indexes differ in q or options (other than sparse), or @p text is not the
+             concatenation of their texts
+    */
+    static QGramIndex merge(const std::string& text, const QGramIndex& first, const QGramIndex& second);
+
     /**
       @brief Returns the text.
       
       @return the full text
     */
     const std::string& getText() const;
+
+    /**
+      @brief Returns the text without copying (for a loaded index, getText() copies the text once).
+    */
+    std::string_view getTextView() const;
     
     /**
       @brief Returns a vector of indices into text, where the q-gram with hash @p h occurs.
@@ -44,36 +210,197 @@ public:
       The vector might be empty, if the q-gram does not exist, i.e. empty range within the suffix array.
       The hash value must be within [0...|SIGMA|^q), otherwise an exception is thrown.
       
-      @note The indices are in reverse order of occurrence in the text, or might be even "unordered"
-      when OpenMP multithreading is used.    
+      @note The indices are in reverse order of occurrence in the text, for any number of OpenMP threads.
       
       @param h Hash value of the q-gram
       @return Vector of hits (indices into text)
       @throws std::invalid_argument("Invalid hash!"); if h is outside of valid hash values
     */
     std::vector<uint32_t> getHits(const uint32_t h) const;
+
+    /**
+      @brief Same as getHits(), for a 64-bit hash (see hash64()); needed for q > 16.
+
+      For a canonical index, @p h may be the hash of either strand; hits on the strand of the key, i.e. the smaller of
+      the two, have STRAND_BIT cleared, hits of its reverse complement have it set.
+
+      @param h Hash value of the q-gram, within [0...|SIGMA|^q)
+      @return Vector of hits (indices into text)
+      @throws std::invalid_argument("Invalid hash!"); if h is outside of valid hash values
+    */
+    std::vector<uint32_t> getHits64(const uint64_t h) const;
+
+    /**
+      @brief Same as getHits64(), but without copying: a view straight into the suffix array.
+
+      The view is valid as long as the index is.
+
+      @param h Hash value of the q-gram, within [0...|SIGMA|^q)
+      @return View of the hits (indices into text), in the same order as getHits()
+      @throws std::invalid_argument("Invalid hash!"); if h is outside of valid hash values
+    */
+    ArrayView<uint32_t> getHitsView(const uint64_t h) const;
+
+    /**
+      @brief getHitsView() for many hashes at once; directory entries and buckets are prefetched ahead of use.
+
+      @param hashes Hash values of the q-grams
+      @param[out] hits One view per hash (resized to hashes.size(); reuse the vector to avoid allocations)
+      @throws std::invalid_argument("Invalid hash!"); if a hash is outside of valid hash values
+    */
+    void getHitsBatch(const std::vector<uint64_t>& hashes, std::vector<ArrayView<uint32_t>>& hits) const;
+
+    /**
+      @brief All occurrences of @p pattern (any length) in the text, in increasing order.
+
+      Seed and verify: the q-gram of the pattern with the smallest bucket (for a minimizer index: the rarest
+      minimizer of the pattern) gives the candidates, which are compared to the text base by base: case-insensitive,
+      characters other than ACGT never match (see sameBase()).
+      A pattern shorter than q is looked up as the range of all q-grams it prefixes (plus the ends of the records).
+      Occurrences never span two records.
+
+      With @p both_strands, occurrences of the reverse complement of @p pattern are reported as well, with STRAND_BIT set
+      (sorted by position). A canonical index finds both with a single seed lookup.
+
+      @param pattern The pattern
+      @param both_strands Also search the reverse complement (text must be shorter than 2^31)
+      @return Start positions of all occurrences
+      @throws std::invalid_argument if @p pattern is empty, or shorter than q + w - 1 (minimizer index), than q (canonical index)
+              or than the seed span (spaced seed)
+    */
+    std::vector<uint32_t> find(const std::string& pattern, const bool both_strands = false) const;
+
+    /**
+      @brief All approximate occurrences of @p pattern with at most @p max_errors edits (or mismatches), by end position.
+
+      Filter and verify, using the q-gram lemma: an occurrence with k errors shares at least t = m - q + 1 - k*q
+      q-grams with the pattern, and all of them lie on diagonals (text position - pattern offset) within k of each other.
+      The hits of all q-grams of the pattern are sorted by diagonal; windows of k+1 diagonals holding at least t hits
+      are merged into regions, and each region is verified with a banded edit distance DP (free start and end in the
+      text), i.e. in O(m*k) instead of O(m*n). With @p mismatches_only, a single diagonal must hold t hits and is
+      verified by counting mismatches.
+      With a spaced seed of span s (weight q), windows of s characters are counted: t = m - s + 1 - k*s, since an
+      error may break every window across it; with @p mismatches_only t = m - s + 1 - k*q, since a mismatch breaks only
+      the windows with a '1' at its position.
+
+      Every end position with an occurrence is reported once, with its minimal number of errors (the same as a full
+      DP over the text would report); occurrences never span two records. Only the forward strand is searched.
+
+      @param pattern The pattern (m characters)
+      @param max_errors Maximal number of errors k
+      @param mismatches_only Hamming distance (substitutions only) instead of edit distance
+      @return Occurrences, sorted by end
+      @throws std::invalid_argument if the filter is void (t < 1, e.g. m < q + k*q), or the index uses minimizers
+    */
+    std::vector<ApproximateMatch> findApproximate(const std::string& pattern, const uint32_t max_errors,
+                                                  const bool mismatches_only = false) const;
+
+    /**
+      @brief Whether the index uses the sparse directory (see QGramOptions).
+    */
+    bool isSparse() const;
+
+    /**
+      @brief Whether q-grams are keyed canonically (see QGramOptions).
+    */
+    bool isCanonical() const;
+
+    /**
+      @brief Number of distinct q-grams in the text.
+    */
+    size_t distinctQGrams() const;
+
+    /**
+      @brief Memory of the index in bytes (suffix array, directory and packed text; without the text).
+      For a loaded index, this is the mapped size of the tables.
+    */
+    size_t sizeInBytes() const;
+
+    /**
+      @brief Visit every distinct q-gram of the directory as visit(hash, count), in increasing order of hash,
+      where count is the size of its bucket (canonical: both strands; with minimizers: the sampled positions only).
+    */
+    template <typename Visit>
+    void forEachBucket(Visit&& visit) const {
+        if (sparse) {
+            for (size_t k = 0; k < keys.size(); k++) visit(keys[k], dir[k + 1] - dir[k]);
+            return;
+        }
+        for (uint64_t h = 0; h <= rolling.maxHash(); h++) {
+            const uint32_t end = (h == rolling.maxHash()) ? uint32_t(suffix_array.size()) : dir[h + 1];
+            if (end != dir[h]) visit(h, end - dir[h]);
+        }
+    }
     
     /**
-      @brief Get the length of q-grams, i.e. 'q'.
+      @brief Get the length of q-grams, i.e. 'q' (with a spaced seed: its weight).
     */
     uint8_t getQ() const;
+
+    /**
+      @brief The seed of the index: contiguous (span q), or spaced (see QGramOptions::seed_mask).
+    */
+    const SpacedSeed& getSeed() const { return seed; }
+
+    /**
+      @brief Number of records (1 unless built with record starts).
+    */
+    size_t getRecordCount() const;
+
+    /**
+      @brief Map a position in the text (e.g. a hit) to (record id, offset within the record).
+
+      @param pos Position in the text
+      @return (record id, offset)
+      @throws std::invalid_argument("Invalid position!") if pos is outside of the text
+    */
+    std::pair<uint32_t, uint32_t> resolve(const uint32_t pos) const;
+
+    /**
+      @brief Minimizer window of the index (1: all q-grams are indexed).
+    */
+    uint32_t getWindow() const;
+
+    /**
+      @brief The (w,q)-minimizers of @p seq for the window of this index, as (offset, 64-bit hash) in increasing offset.
+
+      For an index with window 1, these are all q-grams of @p seq (spaced seed: the keys of all windows of its span).
+      For a canonical index, the hashes are canonical and the offsets carry STRAND_BIT for q-grams that are the
+      reverse complement of their key.
+
+      @param seq A query sequence
+      @param[out] minimizers The minimizers (cleared first)
+    */
+    void getMinimizers(const std::string& seq, std::vector<std::pair<uint32_t, uint64_t>>& minimizers) const;
     
     /**
       @brief Compute a full hash for a given q-gram.
       
       Warning: use this function only when absolutely needed! Prefer hashNext() when possible!
       
-      @param qgram A q-gram; must have size 'q'
+      @param qgram A q-gram; must have size 'q' (spaced seed: its span, the key is extracted)
       @return hash value of @p qgram
       @throws std::invalid_argument("Invalid q-gram. Wrong length!"); if qgram.size() != q
+      @throws std::invalid_argument if q > 16 (use hash64())
       
     */
     uint32_t hash(const std::string& qgram) const;
+
+    /**
+      @brief Compute a full 64-bit hash for a given q-gram (any q).
+
+      @param qgram A q-gram; must have size 'q' (spaced seed: its span, the key is extracted)
+      @return hash value of @p qgram
+      @throws std::invalid_argument("Invalid q-gram. Wrong length!"); if qgram.size() != q
+    */
+    uint64_t hash64(const std::string& qgram) const;
     
     /**
        @brief Returns the next rolling hash for given new character and previous hash (of previous q-gram).
        
        The first character going out-of-scope is removed internally by bitmasking (i.e. no need to specify it).
+       Contiguous q-grams only: for a spaced seed, roll the hash of its span (RollingHash) and extract the key
+       (getSeed()).
        
        @param prev_hash Previous hash value
        @param new_pos new character (last position of current q-gram)
@@ -81,14 +408,101 @@ public:
     */
     uint32_t hashNext(const uint32_t prev_hash, const char new_pos) const;
 
+    /**
+       @brief 64-bit version of hashNext().
+    */
+    uint64_t hashNext64(const uint64_t prev_hash, const char new_pos) const;
+
 private:
+  /// compresses the suffix array of a freshly built index
+  friend class CompressedQGramIndex;
+  struct Mapping;
+  struct IndexWriter;
+  /// Build over @p text (see the public constructor); with @p writer, the suffix array is placed in its file (see buildFile())
+  QGramIndex(std::string_view text, const std::vector<uint32_t>& record_starts, const uint8_t q, const QGramOptions& options,
+             IndexWriter* writer);
+  /// Open a mapped index file (see load())
+  QGramIndex(std::unique_ptr<Mapping> file, const std::string& filename);
+  /// Merge two indexes (see merge(); arguments are checked there)
+  QGramIndex(const std::string& text, const QGramIndex& first, const QGramIndex& second);
+
+  /// Build dir and suffix_array by counting sort over the leading @p bucket_bits of the hashes
+  /// (parallel with OpenMP); bucket_bits = 2q gives the dense index. The suffix array goes to sa_storage,
+  /// or into the file of @p writer; returns it (writable)
+  uint32_t* build(const uint8_t bucket_bits, IndexWriter* writer);
+  /// Turn the partitions left by build() in @p sa into the sparse directory: sort each partition, collect the distinct keys
+  void buildSparse(uint32_t* sa);
+  /// Build the radix table over key_storage (sparse mode)
+  void buildRadix();
+  /// Write the header and the sections to @p out; the suffix array starts at @p sa_offset. With @p tables_only,
+  /// text and suffix array are in the file already and are skipped (see buildFile())
+  void writeFile(std::ostream& out, const uint64_t sa_offset, const bool tables_only) const;
+  /// Point the table views (except suffix_array) at the *_storage vectors
+  void setViews();
+  /// Range [begin, end) of q-gram @p h in the suffix array (empty if it does not occur)
+  std::pair<uint32_t, uint32_t> range(uint64_t h) const;
+  /// Range of the bucket with key @p key, i.e. range() without mapping h to its canonical key
+  std::pair<uint32_t, uint32_t> keyRange(const uint64_t key) const;
+  /// Key of the q-gram at suffix array entry @p entry (canonical: the smaller of both strands)
+  uint64_t keyAt(const uint32_t entry) const;
+  /// A pattern of find(), packed as well if it can be compared on the packed text
+  struct Pattern {
+    Pattern(const std::string& pattern, const bool pack);
+    std::string text;
+    PackedText packed; ///< empty unless the pattern and the text consist of ACGT only (either case)
+  };
+  /// Whether @p pattern occurs at @p pos (within one record)
+  bool occursAt(const Pattern& pattern, const size_t pos) const;
+  /// find() for patterns shorter than q; hits get @p flag
+  void findPrefix(const Pattern& pattern, const uint32_t flag, std::vector<uint32_t>& hits) const;
+  /// find() for patterns of at least q characters; hits get @p flag. With @p rc_pattern (canonical only),
+  /// occurrences of the reverse complement are collected from the same seed
+  void findSeeded(const Pattern& pattern, const uint32_t flag, const Pattern* rc_pattern,
+                  std::vector<uint32_t>& hits) const;
+  /// Banded verification for findApproximate(): all ends of occurrences of @p pattern with at most @p k edits whose
+  /// alignment stays within diagonals [diagonal_begin, diagonal_end] and within record @p r
+  void verifyBanded(const std::string& pattern, const uint32_t k, const int64_t diagonal_begin, const int64_t diagonal_end,
+                    const size_t r, std::vector<ApproximateMatch>& matches) const;
+  /// Index of the first q-gram in suffix_array whose hash is >= @p h
+  uint32_t lowerBound(const uint64_t h) const;
+  /// Slot of @p h in the radix table (sparse mode)
+  size_t radixOf(const uint64_t h) const { return lookup_shift >= 64 ? 0 : h >> lookup_shift; }
+  /// End of record @p r in the text
+  size_t recordEnd(const size_t r) const;
+  /// Number of q-grams in the text (none spans two records)
+  size_t countQGrams() const;
+  /// Call visit(position, hash) for all q-grams starting in [begin, end), hashed from the packed text (none spans two records)
+  template <typename Visit>
+  void forEachQGram(const size_t begin, const size_t end, Visit&& visit) const;
+  /// Same as forEachQGram(), but only for the positions that are indexed (all or the minimizers)
+  template <typename Visit>
+  void forEachSample(const size_t begin, const size_t end, Visit&& visit) const;
+
   const uint8_t q_length;
+  const bool sparse;
+  const uint32_t window;
+  const bool canonical;
+  const RollingHash rolling;    ///< hashes of q characters, i.e. the key space (with a spaced seed: of its weight)
+  const SpacedSeed seed;        ///< windows of seed.span() characters are indexed (contiguous: span = q)
   const uint8_t alphabet_length = 4; // Our alphabet will always consist of {A, C, G, T}
   const uint8_t bit_shift_value = 2; // Valid for as long as there exists a k, so that 2^k = alphabet_length
   uint32_t mask;
-  const std::string& search_text;
-  std::vector<uint32_t> suffix_array;
-  std::vector<uint32_t> dir;
+  const std::string* text_string; ///< the indexed string (nullptr for a loaded index)
+  std::unique_ptr<Mapping> mapping; ///< the index file (nullptr for a built index)
+  const char* search_text;
+  PackedText packed;            ///< the text, packed (built index only; kept only if exact, see PackedText::isExact())
+  // the tables, pointing either into the *_storage vectors or into the mapping
+  ArrayView<uint32_t> suffix_array;
+  ArrayView<uint32_t> dir;      ///< dense: start of every q-gram in suffix_array; sparse: start of keys[k] (plus end sentinel)
+  ArrayView<uint64_t> keys;     ///< sparse: sorted distinct q-gram hashes
+  ArrayView<uint32_t> radix;    ///< sparse: radix[b] = first key whose leading bits are b
+  ArrayView<uint32_t> records;  ///< start of every record in the text (at least one)
+  uint32_t lookup_shift = 64;   ///< sparse: 2q - number of leading bits used for the radix table
+  std::vector<uint32_t> sa_storage;
+  std::vector<uint32_t> dir_storage;
+  std::vector<uint64_t> key_storage;
+  std::vector<uint32_t> radix_storage;
+  std::vector<uint32_t> record_storage;
   size_t search_text_length;
 
 };
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define QG_HAVE_PEXT 1
+#endif
+#include "qg_util.hpp"
+
+/**
+   A spaced seed: a mask over span positions such as "1101101", where only the positions marked '1' (its weight)
+   form the key. A seed hit tolerates mismatches at the '0' positions, and hits of neighbouring windows are less
+   correlated than those of contiguous q-grams, i.e. at the same weight (number of keys, index size) spaced seeds
+   find more of the similar regions between divergent sequences.
+
+   The key is extracted from the 2-bit hash of the whole span (see RollingHash): with BMI2 (compile with -mbmi2
+   or -march=native) by one pext instruction, otherwise by the branch-free compress of Hacker's Delight (7-4):
+   five steps with constant shifts and masks precomputed from the seed. Both are available separately
+   (extractPortable(), extractPext()) to test them against each other.
+   The key of a contiguous seed (all '1') is the plain q-gram hash.
+*/
+class SpacedSeed
+{
+public:
+    /// Contiguous seed of length @p q (1 to 32; not checked)
+    explicit SpacedSeed(const uint8_t q) : SpacedSeed(std::string(q, '1'), false) {}
+
+    /**
+     @param mask '1' (part of the key) or '0' (ignored) per position, starting and ending with '1', at most 32 positions
+     @throws std::invalid_argument("Invalid seed mask!") if @p mask is not of this form
+    */
+    explicit SpacedSeed(const std::string& mask) : SpacedSeed(mask, true) {}
+
+    /// Whether @p mask is a valid spaced seed (see SpacedSeed(const std::string&))
+    static bool isValid(const std::string& mask) {
+        if (mask.empty() || mask.size() > 32 || mask.front() != '1' || mask.back() != '1') return false;
+        return mask.find_first_not_of("01") == std::string::npos;
+    }
+
+    /// Number of positions covered by the seed
+    uint8_t span() const { return uint8_t(mask.size()); }
+
+    /// Number of positions that form the key, i.e. the key has 2 * weight() bits
+    uint8_t weight() const { return seed_weight; }
+
+    bool isContiguous() const { return seed_weight == mask.size(); }
+
+    const std::string& getMask() const { return mask; }
+
+    /// Key of the span with 2-bit hash @p h (see RollingHash::hash() with q = span())
+    uint64_t extract(const uint64_t h) const {
+#ifdef __BMI2__
+        return _pext_u64(h, bits);
+#else
+        return extractPortable(h);
+#endif
+    }
+
+    /// extract() by the compress steps, whatever the target
+    uint64_t extractPortable(const uint64_t h) const {
+        uint64_t key = h & bits;
+        for (unsigned i = 0; i < 5; i++) {
+            const uint64_t t = key & moves[i];
+            key = (key ^ t) | (t >> (2u << i));
+        }
+        return key;
+    }
+
+#ifdef QG_HAVE_PEXT
+    /// extract() by pext, compiled for BMI2 whatever the flags; only call it if the CPU supports BMI2
+    /// (__builtin_cpu_supports("bmi2"))
+    __attribute__((target("bmi2"))) uint64_t extractPext(const uint64_t h) const { return _pext_u64(h, bits); }
+#endif
+
+    /// Key of the span() characters starting at @p s
+    uint64_t hash(const char* s) const {
+        uint64_t h = 0;
+        for (size_t i = 0; i < mask.size(); i++) h = (h << 2) | ordValue(s[i]);
+        return extract(h);
+    }
+
+private:
+    SpacedSeed(const std::string& m, const bool check) : mask(m) {
+        if (check && !isValid(mask)) throw std::invalid_argument("Invalid seed mask!");
+        if (mask.size() > 32) return; // invalid contiguous seed, rejected by the caller
+        // the first position is in the most significant bits of the span hash
+        for (size_t i = 0; i < mask.size(); i++) {
+            if (mask[i] != '1') continue;
+            bits |= uint64_t(3) << 2 * (mask.size() - 1 - i);
+            seed_weight++;
+        }
+        // compress: step i moves the bits with an odd (2 << i)-multiple of zeros to their right by 2 << i; the number
+        // of zeros is even (whole positions), i.e. the 1-bit step of the general algorithm is always empty
+        uint64_t remaining = bits;
+        uint64_t zeros = ~bits << 1; // zeros to the right are counted
+        for (unsigned i = 0; i < 6; i++) {
+            uint64_t prefix = zeros ^ (zeros << 1);
+            prefix ^= prefix << 2;
+            prefix ^= prefix << 4;
+            prefix ^= prefix << 8;
+            prefix ^= prefix << 16;
+            prefix ^= prefix << 32;
+            const uint64_t move = prefix & remaining;
+            remaining = (remaining ^ move) | (move >> (1u << i));
+            zeros &= ~prefix;
+            if (i > 0) moves[i - 1] = move;
+        }
+    }
+
+    std::string mask;
+    uint8_t seed_weight = 0;
+    uint64_t bits = 0;      ///< 2 bits per '1' of the mask, as laid out in the span hash (the pext mask)
+    uint64_t moves[5] = {}; ///< bits moved by 2, 4, 8, 16 and 32 in the steps of extract()
+};
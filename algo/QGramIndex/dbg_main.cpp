@@ -0,0 +1,84 @@
+#include "DeBruijnGraph.hpp"
+#include "qg_fasta.hpp"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+
+namespace {
+
+void usage() {
+    std::cout << "Usage: ./dbg_main <READS> [-k <K>] [--min-count <C>] [--forward] [--out <GFA_FILE>]\n"
+              << "  READS        FASTA or FASTQ file, or plain text (one read per line)\n"
+              << "  -k           k-mer length (default: 31, from 2 to 32); nodes are (k-1)-mers\n"
+              << "  --min-count  drop k-mers occurring fewer than C times (default: 1)\n"
+              << "  --forward    take k-mers as they are, not together with their reverse complement\n"
+              << "  --out        write the unitig graph (GFA) to GFA_FILE instead of stdout\n";
+}
+
+/// Length of the shortest unitig among the longest ones that cover half of the total length
+size_t n50(std::vector<size_t> lengths) {
+    std::sort(lengths.rbegin(), lengths.rend());
+    size_t total = 0;
+    for (const size_t length : lengths) total += length;
+    size_t sum = 0;
+    for (const size_t length : lengths) {
+        sum += length;
+        if (2 * sum >= total) return length;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    std::string gfa_file;
+    DeBruijnOptions options;
+    size_t k = 31;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-k" && i + 1 < argc) k = std::stoul(argv[++i]);
+        else if (arg == "--min-count" && i + 1 < argc) options.min_count = std::stoul(argv[++i]);
+        else if (arg == "--forward") options.canonical = false;
+        else if (arg == "--out" && i + 1 < argc) gfa_file = argv[++i];
+        else args.push_back(arg);
+    }
+    if (args.size() != 1 || k < 2 || k > 32) {
+        usage();
+        return 1;
+    }
+
+    std::ifstream reads(args[0]);
+    if (!reads.is_open()) {
+        std::cout << "Couldn't find the file, check spelling...";
+        return 1;
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        // every read is a record of its own, i.e. no k-mer spans two reads
+        const FastaRecords fasta = readSequences(reads);
+        const DeBruijnGraph graph(fasta.text, fasta.starts, k, options);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::ofstream gfa_out;
+        if (!gfa_file.empty()) {
+            gfa_out.open(gfa_file);
+            if (!gfa_out) throw std::runtime_error("Cannot write '" + gfa_file + "'!");
+        }
+        graph.writeGFA(gfa_file.empty() ? std::cout : gfa_out);
+
+        std::vector<size_t> lengths;
+        for (const Unitig& unitig : graph.getUnitigs()) lengths.push_back(unitig.sequence.size());
+        std::cerr << fasta.starts.size() << " reads, " << graph.kmerCount() << " distinct " << k << "-mers, "
+                  << lengths.size() << " unitigs (N50 " << n50(lengths) << ", longest "
+                  << (lengths.empty() ? 0 : *std::max_element(lengths.begin(), lengths.end()))
+                  << ") (built in " << ms << " ms)\n";
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "KmerCounter.hpp"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+
+namespace {
+
+void usage() {
+    std::cout << "Usage: ./kc_main <READS> [-k <K>] [--forward] [--histo <FILE>] [--out <TABLE>] [--max-count <N>]\n"
+              << "  READS        FASTA or FASTQ file ('-' for stdin), streamed in batches\n"
+              << "  -k           k-mer length (default: 21, at most 32)\n"
+              << "  --forward    count k-mers as they are, not together with their reverse complement\n"
+              << "  --histo      write the k-mer spectrum (<count><TAB><distinct k-mers>) to FILE instead of stdout\n"
+              << "  --out        write the binary count table (see KmerCounter::save()) to TABLE\n"
+              << "  --max-count  last spectrum entry, collects all higher counts (default: 10000)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    std::string histo_file, table_file;
+    KmerOptions options;
+    size_t k = 21, max_count = 10000;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-k" && i + 1 < argc) k = std::stoul(argv[++i]);
+        else if (arg == "--forward") options.canonical = false;
+        else if (arg == "--histo" && i + 1 < argc) histo_file = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) table_file = argv[++i];
+        else if (arg == "--max-count" && i + 1 < argc) max_count = std::stoul(argv[++i]);
+        else args.push_back(arg);
+    }
+    if (args.size() != 1 || k < 1 || k > 32 || max_count < 1) {
+        usage();
+        return 1;
+    }
+
+    std::ifstream file;
+    if (args[0] != "-") {
+        file.open(args[0]);
+        if (!file.is_open()) {
+            std::cout << "Couldn't find the file, check spelling...";
+            return 1;
+        }
+    }
+    std::istream& reads = (args[0] == "-") ? std::cin : file;
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        KmerCounter counter(k, options);
+        const size_t read_count = counter.count(reads);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        const std::vector<uint64_t> histogram = counter.histogram(max_count + 1);
+        std::ofstream histo_out;
+        if (!histo_file.empty()) {
+            histo_out.open(histo_file);
+            if (!histo_out) throw std::runtime_error("Cannot write '" + histo_file + "'!");
+        }
+        std::ostream& out = histo_file.empty() ? std::cout : histo_out;
+        for (size_t c = 1; c < histogram.size(); c++) {
+            if (histogram[c] > 0) out << c << "\t" << histogram[c] << "\n";
+        }
+        if (!table_file.empty()) counter.save(table_file);
+
+        std::cerr << read_count << " reads, " << counter.total() << " " << k << "-mers, "
+                  << counter.distinct() << " distinct (counted in " << ms << " ms)\n";
+        const uint64_t genome_size = estimateGenomeSize(histogram);
+        if (genome_size > 0) std::cerr << "estimated genome size: " << genome_size << "\n";
+        else std::cerr << "estimated genome size: n/a (no coverage peak in the spectrum)\n";
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
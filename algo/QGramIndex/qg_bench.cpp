@@ -0,0 +1,389 @@
+// compile with
+// make qg_bench
+//
+// Builds a QGramIndex for every q over synthetic and real genomes and reports construction time, peak memory,
+// the latency distribution of single q-gram lookups, lookups and hits per second of batched lookups, and the
+// latency of find() for longer patterns. With --json, the results are written as JSON as well, to compare runs.
+//
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <omp.h>
+#include <sys/resource.h>
+
+#include "QGramIndex.hpp"
+#include "qg_fasta.hpp"
+#include "qg_util.hpp"
+
+using namespace std;
+
+struct Genome
+{
+  string name;
+  FastaRecords records;
+};
+
+static volatile uint64_t hit_checksum;
+
+/// Latency distribution in ns
+struct Latency
+{
+  double p50 = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+struct Result
+{
+  string genome;
+  size_t length = 0;
+  unsigned q = 0;
+  bool sparse = false;
+  double build_s = 0;
+  double peak_mb = 0;     ///< peak resident memory during construction
+  double index_mb = 0;    ///< QGramIndex::sizeInBytes()
+  size_t distinct = 0;
+  size_t lookups = 0;
+  Latency lookup;
+  double lookups_per_s = 0;
+  double hits_per_s = 0;
+  size_t patterns = 0;
+  Latency find;
+  double finds_per_s = 0;
+};
+
+/// Reset the peak RSS counter (Linux only; otherwise the peak is process-wide)
+static void resetPeakRSS()
+{
+  ofstream clear("/proc/self/clear_refs");
+  if (clear.good()) clear << "5";
+}
+
+/// Value of the line @p key (e.g. "VmHWM:") of /proc/self/status in MB; 0 if not available
+static double procStatusMB(const string& key)
+{
+  ifstream status("/proc/self/status");
+  string line;
+  while (getline(status, line))
+  {
+    if (line.rfind(key, 0) == 0) return stod(line.substr(key.size())) / 1024.0;
+  }
+  return 0;
+}
+
+/// Peak resident set size in MB since the last resetPeakRSS()
+static double peakRSS()
+{
+  const double peak = procStatusMB("VmHWM:");
+  if (peak > 0) return peak;
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+static string randomDNA(size_t len, mt19937& rng)
+{
+  string s(len, 'A');
+  for (auto& c : s) c = "ACGT"[rng() % 4];
+  return s;
+}
+
+/// Random genome of @p len bases where about half are copies of 200 repeat families (300 bp, 10% substitutions),
+/// i.e. skewed bucket sizes as in real genomes
+static string repetitiveDNA(size_t len, mt19937& rng)
+{
+  vector<string> families;
+  for (int i = 0; i < 200; ++i) families.push_back(randomDNA(300, rng));
+  string s;
+  s.reserve(len + 300);
+  while (s.size() < len)
+  {
+    if (rng() % 2)
+    {
+      s += randomDNA(300, rng);
+      continue;
+    }
+    string copy = families[rng() % families.size()];
+    for (auto& c : copy)
+    {
+      if (rng() % 10 == 0) c = "ACGT"[rng() % 4];
+    }
+    s += copy;
+  }
+  s.resize(len);
+  return s;
+}
+
+static Latency distribution(vector<double> v)
+{
+  Latency l;
+  if (v.empty()) return l;
+  sort(v.begin(), v.end());
+  auto at = [&v](double p) { return v[min(v.size() - 1, size_t(p * (v.size() - 1) + 0.5))]; };
+  l.p50 = at(0.5);
+  l.p90 = at(0.9);
+  l.p99 = at(0.99);
+  l.max = v.back();
+  return l;
+}
+
+static double secondsSince(chrono::steady_clock::time_point begin)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+/// Random windows of one length that lie within a record (q-grams and find() hits never span two records): a record
+/// is picked by its number of windows, then a window inside it, i.e. every such window is equally likely
+struct WindowSampler
+{
+  WindowSampler(const FastaRecords& records, size_t length) : starts(records.starts)
+  {
+    uint64_t total = 0;
+    for (size_t r = 0; r < starts.size(); ++r)
+    {
+      const size_t end = (r + 1 < starts.size()) ? starts[r + 1] : records.text.size();
+      if (end - starts[r] >= length) total += end - starts[r] - length + 1; // shorter records have none
+      windows.push_back(total);
+    }
+  }
+
+  bool empty() const { return windows.empty() || windows.back() == 0; }
+
+  /// Start of a random window (unless empty())
+  size_t operator()(mt19937& rng) const
+  {
+    const uint64_t i = ((uint64_t(rng()) << 32) | rng()) % windows.back();
+    const size_t r = upper_bound(windows.begin(), windows.end(), i) - windows.begin();
+    return starts[r] + (i - (r > 0 ? windows[r - 1] : 0));
+  }
+
+  const vector<uint32_t>& starts;
+  vector<uint64_t> windows; ///< number of windows in the records up to and including r
+};
+
+static Result bench(const Genome& genome, unsigned q, size_t lookups, size_t patterns, size_t pattern_length, mt19937& rng)
+{
+  const string& text = genome.records.text;
+  Result r;
+  r.genome = genome.name;
+  r.length = text.size();
+  r.q = q;
+  r.sparse = q > 13;
+  QGramOptions options;
+  options.sparse = r.sparse;
+
+  resetPeakRSS();
+  auto begin = chrono::steady_clock::now();
+  const QGramIndex index(text, genome.records.starts, q, options);
+  r.build_s = secondsSince(begin);
+  r.peak_mb = peakRSS();
+  r.index_mb = index.sizeInBytes() / 1048576.0;
+  r.distinct = index.distinctQGrams();
+
+  // lookups: q-grams of the text (every one has hits) and random ones (mostly absent for large q)
+  vector<uint64_t> hashes;
+  const uint64_t max_hash = q == 32 ? ~uint64_t(0) : (uint64_t(1) << 2 * q) - 1;
+  const WindowSampler qgrams(genome.records, q);
+  for (size_t i = 0; i < lookups && !qgrams.empty(); ++i)
+  {
+    if (i % 2) hashes.push_back(((uint64_t(rng()) << 32) | rng()) & max_hash);
+    else hashes.push_back(index.hash64(text.substr(qgrams(rng), q)));
+  }
+  r.lookups = hashes.size();
+  vector<double> latency;
+  latency.reserve(hashes.size());
+  size_t hits = 0;
+  for (const uint64_t h : hashes)
+  {
+    begin = chrono::steady_clock::now();
+    hits += index.getHitsView(h).size();
+    latency.push_back(secondsSince(begin) * 1e9);
+  }
+  r.lookup = distribution(latency);
+  // throughput: batched lookups (prefetching), touching every hit
+  vector<ArrayView<uint32_t>> views;
+  hits = 0;
+  uint64_t checksum = 0;
+  begin = chrono::steady_clock::now();
+  index.getHitsBatch(hashes, views);
+  for (const auto& view : views)
+  {
+    hits += view.size();
+    for (const uint32_t pos : view) checksum += pos;
+  }
+  const double batch_s = secondsSince(begin);
+  if (batch_s > 0)
+  {
+    r.lookups_per_s = hashes.size() / batch_s;
+    r.hits_per_s = hits / batch_s;
+  }
+  hit_checksum = checksum; // keeps the loop over the hits
+
+  // find(): patterns from the text, verified against it (without N & co., which never match)
+  vector<string> queries;
+  const WindowSampler windows(genome.records, pattern_length);
+  for (size_t tries = 0; queries.size() < patterns && !windows.empty() && tries < 100 * patterns; ++tries)
+  {
+    const string query = text.substr(windows(rng), pattern_length);
+    if (sameBases(query.data(), query.data(), query.size())) queries.push_back(query);
+  }
+  r.patterns = queries.size();
+  latency.clear();
+  double find_s = 0;
+  for (const string& query : queries)
+  {
+    begin = chrono::steady_clock::now();
+    const size_t found = index.find(query).size();
+    const double s = secondsSince(begin);
+    find_s += s;
+    latency.push_back(s * 1e9);
+    if (found == 0) cerr << "find() missed a pattern of the text -- go fix your code!\n";
+  }
+  r.find = distribution(latency);
+  if (find_s > 0) r.finds_per_s = queries.size() / find_s;
+  return r;
+}
+
+static string jsonString(const string& s)
+{
+  ostringstream out;
+  out << '"';
+  for (const char c : s)
+  {
+    if (c == '"' || c == '\\') out << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20) out << "\\u" << hex << setw(4) << setfill('0') << int(c) << dec;
+    else out << c;
+  }
+  out << '"';
+  return out.str();
+}
+
+static void writeLatency(ostream& out, const Latency& l)
+{
+  out << "{\"p50\": " << l.p50 << ", \"p90\": " << l.p90 << ", \"p99\": " << l.p99 << ", \"max\": " << l.max << "}";
+}
+
+static void writeJson(ostream& out, const vector<Result>& results)
+{
+  out << fixed << setprecision(3);
+  out << "{\n  \"benchmark\": \"qg_bench\",\n  \"threads\": " << omp_get_max_threads() << ",\n  \"results\": [";
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const Result& r = results[i];
+    out << (i ? ",\n" : "\n") << "    {\"genome\": " << jsonString(r.genome) << ", \"length\": " << r.length
+        << ", \"q\": " << r.q << ", \"sparse\": " << (r.sparse ? "true" : "false")
+        << ", \"build_s\": " << r.build_s << ", \"peak_mb\": " << r.peak_mb << ", \"index_mb\": " << r.index_mb
+        << ", \"distinct_qgrams\": " << r.distinct
+        << ",\n     \"lookup\": {\"count\": " << r.lookups << ", \"latency_ns\": ";
+    writeLatency(out, r.lookup);
+    out << ", \"lookups_per_s\": " << r.lookups_per_s << ", \"hits_per_s\": " << r.hits_per_s << "}"
+        << ",\n     \"find\": {\"count\": " << r.patterns << ", \"latency_ns\": ";
+    writeLatency(out, r.find);
+    out << ", \"patterns_per_s\": " << r.finds_per_s << "}}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+int main(int argc, const char* argv[])
+{
+  vector<unsigned> qs = {4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 16, 20, 24, 32};
+  size_t length = 10000000;
+  size_t lookups = 100000, patterns = 10000, pattern_length = 50;
+  vector<string> fastas;
+  string json;
+  bool synthetic = true;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    string arg = argv[i];
+    if (arg == "--fasta" && i + 1 < argc) fastas.push_back(argv[++i]);
+    else if (arg == "--length" && i + 1 < argc) length = size_t(atof(argv[++i]));
+    else if (arg == "--lookups" && i + 1 < argc) lookups = size_t(atof(argv[++i]));
+    else if (arg == "--patterns" && i + 1 < argc) patterns = size_t(atof(argv[++i]));
+    else if (arg == "--pattern-length" && i + 1 < argc) pattern_length = stoul(argv[++i]);
+    else if (arg == "--json" && i + 1 < argc) json = argv[++i];
+    else if (arg == "--no-synthetic") synthetic = false;
+    else if (arg == "--q" && i + 1 < argc)
+    {
+      qs.clear();
+      stringstream ss(argv[++i]);
+      for (string tok; getline(ss, tok, ',');) qs.push_back(stoul(tok));
+    }
+    else
+    {
+      cerr << "Usage: " << argv[0] << " [--q 4,5,...] [--length N] [--fasta <genome.fasta>]... [--no-synthetic] [--json <FILE>]\n"
+           << "  --q               q values (default 4..13 dense, 16,20,24,32 sparse)\n"
+           << "  --length          length of the synthetic genomes (default 1e7): uniform random, and half repeats\n"
+           << "  --fasta           also benchmark this (multi-)FASTA genome (repeatable)\n"
+           << "  --no-synthetic    only the --fasta genomes\n"
+           << "  --lookups         q-gram lookups per index (default 1e5; half of them q-grams of the text)\n"
+           << "  --patterns        find() patterns per index (default 1e4), of --pattern-length characters (default 50)\n"
+           << "  --json            also write the results as JSON to FILE ('-': stdout, instead of the table)\n";
+      return 1;
+    }
+  }
+  for (const unsigned q : qs)
+  {
+    if (q < 1 || q > 32)
+    {
+      cerr << "Invalid q: " << q << "\n";
+      return 1;
+    }
+  }
+
+  vector<Genome> genomes;
+  mt19937 rng(1234);
+  if (synthetic)
+  {
+    genomes.push_back({"random", {randomDNA(length, rng), {"random"}, {0}}});
+    genomes.push_back({"repeats", {repetitiveDNA(length, rng), {"repeats"}, {0}}});
+  }
+  for (const string& file : fastas)
+  {
+    ifstream is(file);
+    if (!is.good())
+    {
+      cerr << "Cannot open file '" << file << "'\n";
+      return 1;
+    }
+    genomes.push_back({file, readFasta(is, file)});
+  }
+
+  ostream& table = (json == "-") ? cerr : cout;
+  table << left << setw(12) << "genome" << right << setw(12) << "length" << setw(4) << "q"
+        << setw(10) << "build[s]" << setw(10) << "peak[MB]" << setw(10) << "idx[MB]"
+        << setw(10) << "p50[ns]" << setw(10) << "p99[ns]" << setw(12) << "lookups/s" << setw(12) << "hits/s"
+        << setw(12) << "find50[us]" << "\n";
+  vector<Result> results;
+  for (const Genome& genome : genomes)
+  {
+    for (const unsigned q : qs)
+    {
+      const Result r = bench(genome, q, lookups, patterns, pattern_length, rng);
+      const string name = genome.name.size() > 11 ? "..." + genome.name.substr(genome.name.size() - 8) : genome.name;
+      table << left << setw(12) << name << right << setw(12) << r.length << setw(4) << r.q << fixed
+            << setw(10) << setprecision(3) << r.build_s << setw(10) << setprecision(1) << r.peak_mb
+            << setw(10) << r.index_mb << setw(10) << setprecision(0) << r.lookup.p50 << setw(10) << r.lookup.p99
+            << setw(12) << setprecision(3) << scientific << r.lookups_per_s << setw(12) << r.hits_per_s << fixed
+            << setw(12) << setprecision(1) << r.find.p50 / 1e3 << "\n";
+      results.push_back(r);
+    }
+  }
+
+  if (json == "-") writeJson(cout, results);
+  else if (!json.empty())
+  {
+    ofstream out(json);
+    if (!out.good())
+    {
+      cerr << "Cannot write '" << json << "'\n";
+      return 1;
+    }
+    writeJson(out, results);
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include "qg_fasta.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+FastaRecords readFasta(std::istream& input, const std::string& default_name) {
+    FastaRecords records;
+    forEachFastaLine(input, default_name,
+                     [&records](const std::string& name) {
+                         records.names.push_back(name);
+                         records.starts.push_back(records.text.size());
+                     },
+                     [&records](const std::string& line) {
+                         records.text += line;
+                         if (records.text.size() > std::numeric_limits<uint32_t>::max())
+                             throw std::runtime_error("FASTA input exceeds 2^32 bases!");
+                     });
+    return records;
+}
+
+FastaRecords readSequences(std::istream& input) {
+    FastaRecords records;
+    SequenceReader reader(input);
+    std::string name, seq;
+    while (reader.next(name, seq)) {
+        if (records.text.size() + seq.size() > std::numeric_limits<uint32_t>::max())
+            throw std::runtime_error("Input exceeds 2^32 bases!");
+        records.names.push_back(name.empty() ? std::to_string(records.names.size() + 1) : name);
+        records.starts.push_back(records.text.size());
+        records.text += seq;
+    }
+    return records;
+}
+
+bool SequenceReader::nextLine(std::string& line) {
+    while (std::getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) return true;
+    }
+    return false;
+}
+
+bool SequenceReader::next(std::string& name, std::string& seq) {
+    seq.clear();
+    std::string line;
+    if (has_header) {
+        line.swap(header);
+        has_header = false;
+    } else if (!nextLine(line)) {
+        return false;
+    }
+
+    if (line[0] == '@') {
+        // FASTQ: sequence, '+' separator and quality line
+        name = line.substr(1, line.find_first_of(" \t") - 1);
+        if (nextLine(line)) seq = line;
+        if (nextLine(line) && line[0] == '+') nextLine(line);
+        return true;
+    }
+    if (line[0] != '>') {
+        // plain text without header
+        name.clear();
+        seq = line;
+        return true;
+    }
+    name = line.substr(1, line.find_first_of(" \t") - 1);
+    while (nextLine(line)) {
+        if (line[0] == '>') {
+            header.swap(line);
+            has_header = true;
+            break;
+        }
+        seq += line;
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+/// The records of a (multi-)FASTA file, concatenated into one text (see QGramIndex's record constructor)
+struct FastaRecords
+{
+  std::string text;                ///< all sequences, concatenated without separator
+  std::vector<std::string> names;  ///< name of every record (header up to the first whitespace)
+  std::vector<uint32_t> starts;    ///< start of every record in text
+};
+
+/// Stream a FASTA file line by line, in the format of readFasta(): @p record(name) at the start of every record,
+/// then @p sequence(line) for each of its sequence lines ('\r' dropped). Holds one line in memory at a time.
+template <typename Record, typename Sequence>
+void forEachFastaLine(std::istream& input, const std::string& default_name, Record&& record, Sequence&& sequence)
+{
+  std::string line;
+  bool has_record = false;
+  while (std::getline(input, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (!line.empty() && line[0] == '>') {
+      record(line.substr(1, line.find_first_of(" \t") - 1));
+      has_record = true;
+      continue;
+    }
+    if (!has_record) {
+      // plain text without header
+      record(default_name);
+      has_record = true;
+    }
+    sequence(line);
+  }
+}
+
+/// Read all records of a FASTA stream (multi-line sequences are joined, '\r' is dropped).
+/// Input without a '>' header is read as a single record named after @p default_name, one sequence per line.
+/// @throws std::runtime_error if the total sequence length exceeds 2^32 - 1
+FastaRecords readFasta(std::istream& input, const std::string& default_name = "sequence");
+
+/// Read all records of a FASTA or FASTQ stream with SequenceReader, every read (or plain text line) a record of its
+/// own; records without a name are named after their number (1, 2, ...).
+/// @throws std::runtime_error if the total sequence length exceeds 2^32 - 1
+FastaRecords readSequences(std::istream& input);
+
+/**
+   Streams the records of a FASTA or FASTQ file one at a time, i.e. without holding the whole file in memory.
+
+   FASTA records may span several lines; FASTQ records are four lines (header, sequence, '+', qualities) and the
+   qualities are skipped. Lines without any header are returned one by one, each as its own record. '\r' is dropped.
+*/
+class SequenceReader
+{
+public:
+  explicit SequenceReader(std::istream& input) : input(input) {}
+
+  /// Read the next record into @p name and @p seq; returns false at the end of the input
+  bool next(std::string& name, std::string& seq);
+
+private:
+  bool nextLine(std::string& line);
+
+  std::istream& input;
+  std::string header;          ///< FASTA header already read by the previous record
+  bool has_header = false;
+};
@@ -1,47 +1,175 @@
 #include "QGramIndex.hpp"
+#include "CompressedQGramIndex.hpp"
+#include "IncrementalQGramIndex.hpp"
+#include "qg_fasta.hpp"
+#include "qg_server.hpp"
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <chrono>
+#include <algorithm>
 
-int main(int argc, char** argv) {
-    // std::string pattern = "ACCGTCGTC";
-    // uint8_t q_length = 2;
-    // QGramIndex instance(pattern, q_length);
-    // instance.getHits(instance.hash("AA"));
-    if (argc != 3) {
-        std::cout << "Usage: ./aufgabe5_main <GENOME_FILE> <QUERY>";
-        return 1;
+namespace {
+
+void usage() {
+    std::cout << "Usage: ./aufgabe5_main <GENOME_FILE> <QUERY> [--save <INDEX_FILE> [--stream]] [-q <Q> | --seed <MASK>] [--window <W>] [--compressed] [--errors <K> [--hamming]] [--hits]\n"
+              << "       ./aufgabe5_main --index <INDEX_FILE> <QUERY> [--errors <K> [--hamming]] [--hits] [--add <FASTA_FILE> --save <INDEX_FILE>]\n"
+              << "       ./aufgabe5_main (<GENOME_FILE> | --index <INDEX_FILE>) --serve [--socket <PATH>] [--batch <N>] [options as above]\n"
+              << "  GENOME_FILE  (multi-)FASTA file, or plain text\n"
+              << "  QUERY        pattern of any length (seed and verify, see QGramIndex::find())\n"
+              << "  --save       write the index to INDEX_FILE\n"
+              << "  --stream     with --save: build the index straight into INDEX_FILE, streaming GENOME_FILE (text and\n"
+              << "               suffix array are never held in memory, see QGramIndex::buildFile())\n"
+              << "  -q           q-gram length of the index (default: length of QUERY, at most 32)\n"
+              << "  --seed       index the spaced seed MASK (e.g. 1101101: only the '1' positions form the key) instead of\n"
+              << "               contiguous q-grams; q is the number of '1's, QUERY needs >= |MASK| characters\n"
+              << "  --index      open an index written by --save instead of building one\n"
+              << "  --add        append the records of FASTA_FILE to the opened index (merging, no rebuild), then --save it\n"
+              << "  --window     only index the (W,q)-minimizers (~2/(W+1) of all positions); QUERY needs >= q+W-1 characters\n"
+              << "  --compressed Elias-Fano coded buckets (smaller, slower; QUERY needs >= q characters; no --save)\n"
+              << "  --errors     find occurrences with up to K edits (q-gram filter, see QGramIndex::findApproximate());\n"
+              << "               default q: |QUERY| / (K+1), at most 12\n"
+              << "  --hamming    with --errors: mismatches only\n"
+              << "  --serve      build or open the index once, then answer queries (one per line) from stdin until its end,\n"
+              << "               in parallel batches; throughput and latency percentiles go to stderr\n"
+              << "  --socket     with --serve: read queries from connections to the Unix socket PATH instead (served forever)\n"
+              << "  --batch      with --serve: at most N queries per batch (default: 4096); default q with --serve: 12\n"
+              << "  --hits       print every hit as <record><TAB><offset> (--errors: plus <TAB><length><TAB><errors>)\n";
+}
+
+/// Answer @p query (see answerQuery()), or with @p serve all queries of stdin or the socket @p socket_path
+/// (see serveQueries(); statistics go to stderr)
+void run(const QGramIndex& index, const std::string& query, const std::vector<std::string>& names, const ServeOptions& options,
+         const bool serve, const std::string& socket_path) {
+    if (!serve) {
+        std::cout << answerQuery(index, query, names, options);
+        return;
+    }
+    if (!socket_path.empty()) {
+        std::cerr << "(serving queries on '" << socket_path << "')\n";
+        serveSocket(index, socket_path, names, options, std::cerr);
+        return;
     }
+    std::ios::sync_with_stdio(false); // lets serveQueries() see whether more queries are buffered
+    serveQueries(index, std::cin, std::cout, names, options).print(std::cerr);
+}
 
-    uint32_t q_length = std::strlen(argv[2]);
+} // namespace
 
+int main(int argc, char** argv) {
+    std::vector<std::string> args;
+    std::string index_file, save_file, add_file, seed_mask, socket_path;
+    bool compressed = false, stream = false, serve = false;
+    ServeOptions serve_options;
+    uint32_t window = 1;
+    size_t q = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--index" && i + 1 < argc) index_file = argv[++i];
+        else if (arg == "--save" && i + 1 < argc) save_file = argv[++i];
+        else if (arg == "--add" && i + 1 < argc) add_file = argv[++i];
+        else if (arg == "-q" && i + 1 < argc) q = std::stoul(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed_mask = argv[++i];
+        else if (arg == "--window" && i + 1 < argc) window = std::stoul(argv[++i]);
+        else if (arg == "--hits") serve_options.print_hits = true;
+        else if (arg == "--compressed") compressed = true;
+        else if (arg == "--stream") stream = true;
+        else if (arg == "--errors" && i + 1 < argc) serve_options.max_errors = std::stoi(argv[++i]);
+        else if (arg == "--hamming") serve_options.hamming = true;
+        else if (arg == "--serve") serve = true;
+        else if (arg == "--socket" && i + 1 < argc) socket_path = argv[++i];
+        else if (arg == "--batch" && i + 1 < argc) serve_options.batch_size = std::stoul(argv[++i]);
+        else args.push_back(arg);
+    }
+    if (args.size() != (index_file.empty() ? 2u : 1u) - serve || (!index_file.empty() && save_file.empty() != add_file.empty())
+        || (!socket_path.empty() && !serve) || (serve && compressed)
+        || (!add_file.empty() && index_file.empty())
+        || (!seed_mask.empty() && (q != 0 || window != 1 || compressed || !index_file.empty()))
+        || (compressed && (!index_file.empty() || !save_file.empty() || serve_options.max_errors >= 0))
+        || (stream && (save_file.empty() || !index_file.empty() || compressed))) {
+        usage();
+        return 1;
+    }
+    const std::string query = serve ? "" : args.back();
 
-    std::ifstream genome(argv[1]);
-    std::string text;
-    if (genome.is_open()) {
-        if (std::getline(genome, text)) {
-            // Success, do nothing
-        }
-        else {
-            std::cout << "Couldn't read the file, try something else...";
-            return 1;
+    if (!index_file.empty()) {
+        try {
+            auto start = std::chrono::steady_clock::now();
+            QGramIndex instance = QGramIndex::load(index_file);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "(index opened in " << ms << " ms)\n";
+            if (add_file.empty()) {
+                run(instance, query, {}, serve_options, serve, socket_path);
+                return 0;
+            }
+            std::ifstream added(add_file);
+            if (!added.is_open()) throw std::runtime_error("Cannot open '" + add_file + "'!");
+            const FastaRecords fasta = readFasta(added, add_file);
+            if (fasta.starts.empty()) throw std::runtime_error("No records in '" + add_file + "'!");
+            std::vector<std::string> sequences;
+            for (size_t r = 0; r < fasta.starts.size(); r++) {
+                const size_t end = (r + 1 < fasta.starts.size()) ? fasta.starts[r + 1] : fasta.text.size();
+                sequences.push_back(fasta.text.substr(fasta.starts[r], end - fasta.starts[r]));
+            }
+            IncrementalQGramIndex grown(std::move(instance));
+            grown.add(sequences);
+            grown.save(save_file);
+            run(QGramIndex::load(save_file), query, {}, serve_options, serve, socket_path);
+        } catch (const std::exception &e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 2;
         }
-        genome.close();
+        return 0;
     }
-    else {
+
+    std::ifstream genome(args[0]);
+    if (!genome.is_open()) {
         std::cout << "Couldn't find the file, check spelling...";
         return 1;
     }
 
     try {
-        QGramIndex instance(text, q_length);
-        std::vector<uint32_t> matches = instance.getHits(instance.hash(argv[2]));
-
-        std::cout << argv[2] << ": " << q_length << " " << matches.size() << "\n";
+        // the dense directory has 4^q entries; beyond q = 13 switch to the sparse one (64-bit hashes, q <= 32)
+        QGramOptions options;
+        if (!seed_mask.empty()) {
+            options.seed_mask = seed_mask;
+            q = std::count(seed_mask.begin(), seed_mask.end(), '1');
+        }
+        const int max_errors = serve_options.max_errors;
+        if (q == 0 && serve) q = 12; // the queries are not known yet
+        if (q == 0) q = (max_errors >= 0) ? std::clamp<size_t>(query.size() / (max_errors + 1), 1, 12) : std::min<size_t>(query.size(), 32);
+        options.sparse = q > 13;
+        options.window = window;
+        if (stream) {
+            std::vector<std::string> names;
+            auto start = std::chrono::steady_clock::now();
+            QGramIndex instance = QGramIndex::buildFile(genome, save_file, q, options, &names);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "(index built into '" << save_file << "' in " << ms << " ms)\n";
+            run(instance, query, names, serve_options, serve, socket_path);
+            return 0;
+        }
+        FastaRecords fasta = readFasta(genome, args[0]);
+        if (fasta.text.empty()) {
+            std::cout << "Couldn't read the file, try something else...";
+            return 1;
+        }
+        if (compressed) {
+            CompressedQGramIndex instance(fasta.text, fasta.starts, q, options);
+            const std::vector<uint32_t> matches = instance.find(query);
+            std::cout << query << ": " << query.size() << " " << matches.size() << "\n";
+            std::cerr << "(" << instance.sizeInBytes() << " bytes for " << instance.size() << " positions, "
+                      << 8.0 * instance.sizeInBytes() / std::max<size_t>(instance.size(), 1) << " bits each, directory included)\n";
+            return 0;
+        }
+        QGramIndex instance(fasta.text, fasta.starts, q, options);
+        // save first: a server only returns at the end of its input, or never (--socket)
+        if (!save_file.empty()) instance.save(save_file);
+        run(instance, query, fasta.names, serve_options, serve, socket_path);
     } catch (const std::exception &e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 2;
     }
 
     return 0;
-}
\ No newline at end of file
+}
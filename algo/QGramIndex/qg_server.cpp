@@ -0,0 +1,200 @@
+#include "qg_server.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <omp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/// Closes the file descriptor it owns
+struct FileDescriptor {
+    explicit FileDescriptor(const int fd) : fd(fd) {}
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    ~FileDescriptor() { if (fd >= 0) ::close(fd); }
+    const int fd;
+};
+
+/// Buffered reading and writing of a socket, as a streambuf; in_avail() also counts the bytes waiting in the socket
+class SocketBuf : public std::streambuf
+{
+public:
+    explicit SocketBuf(const int fd) : fd(fd) {
+        setg(input, input, input);
+        setp(output, output + sizeof(output));
+    }
+
+    ~SocketBuf() override { flush(); }
+
+protected:
+    int_type underflow() override {
+        ssize_t n;
+        do n = ::read(fd, input, sizeof(input)); while (n < 0 && errno == EINTR);
+        if (n <= 0) return traits_type::eof();
+        setg(input, input, input + n);
+        return traits_type::to_int_type(input[0]);
+    }
+
+    std::streamsize showmanyc() override {
+        int pending = 0;
+        return (::ioctl(fd, FIONREAD, &pending) == 0 && pending > 0) ? pending : 0;
+    }
+
+    int_type overflow(const int_type c) override {
+        if (!flush()) return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override { return flush() ? 0 : -1; }
+
+private:
+    /// Write the put area; a client that went away is an error, not a SIGPIPE
+    bool flush() {
+        for (const char* p = pbase(); p < pptr();) {
+            const ssize_t n = ::send(fd, p, pptr() - p, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return false;
+            p += n;
+        }
+        setp(output, output + sizeof(output));
+        return true;
+    }
+
+    const int fd;
+    char input[1 << 16];
+    char output[1 << 16];
+};
+
+} // namespace
+
+double ServeStats::percentile(const double p) const {
+    if (latencies.empty()) return 0;
+    std::vector<double> sorted(latencies);
+    const size_t rank = std::clamp<size_t>(size_t(std::ceil(p / 100 * sorted.size())), 1, sorted.size());
+    std::nth_element(sorted.begin(), sorted.begin() + (rank - 1), sorted.end());
+    return sorted[rank - 1];
+}
+
+void ServeStats::print(std::ostream& out) const {
+    out << queries << " queries in " << batches << " batches, " << seconds << " s answering ("
+        << (seconds > 0 ? queries / seconds : 0) << " queries/s); latency ms p50 " << percentile(50)
+        << " p90 " << percentile(90) << " p99 " << percentile(99) << " max " << percentile(100) << "\n";
+}
+
+std::string answerQuery(const QGramIndex& index, const std::string& query, const std::vector<std::string>& names,
+                        const ServeOptions& options) {
+    std::ostringstream out;
+    const auto printHit = [&](const uint32_t pos) {
+        const auto [record, offset] = index.resolve(pos);
+        if (record < names.size()) out << names[record];
+        else out << "#" << record;
+        out << "\t" << offset;
+    };
+    if (options.max_errors >= 0) {
+        const std::vector<ApproximateMatch> matches = index.findApproximate(query, options.max_errors, options.hamming);
+        out << query << ": " << query.size() << " " << matches.size() << "\n";
+        if (!options.print_hits) return out.str();
+        for (const auto& match : matches) {
+            printHit(match.begin);
+            out << "\t" << match.end - match.begin << "\t" << match.errors << "\n";
+        }
+        return out.str();
+    }
+    const std::vector<uint32_t> matches = index.find(query);
+    out << query << ": " << query.size() << " " << matches.size() << "\n";
+    if (!options.print_hits) return out.str();
+    for (const uint32_t hit : matches) {
+        printHit(hit);
+        out << "\n";
+    }
+    return out.str();
+}
+
+ServeStats serveQueries(const QGramIndex& index, std::istream& in, std::ostream& out,
+                        const std::vector<std::string>& names, const ServeOptions& options) {
+    ServeStats stats;
+    const size_t batch_size = std::max<size_t>(options.batch_size, 1);
+    std::vector<std::string> batch;
+    std::vector<std::string> answers;
+    std::string line;
+    while (in) {
+        // collect a batch, but never wait for more input once there is a query to answer
+        batch.clear();
+        while (batch.size() < batch_size && std::getline(in, line)) {
+            const size_t begin = line.find_first_not_of(" \t\r");
+            if (begin != std::string::npos) batch.push_back(line.substr(begin, line.find_last_not_of(" \t\r") + 1 - begin));
+            if (!batch.empty() && in.rdbuf()->in_avail() <= 0) break;
+        }
+        if (batch.empty()) continue;
+
+        const Clock::time_point start = Clock::now();
+        const size_t first = stats.latencies.size();
+        stats.latencies.resize(first + batch.size());
+        answers.assign(batch.size(), std::string());
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (size_t i = 0; i < batch.size(); i++) {
+            try {
+                answers[i] = answerQuery(index, batch[i], names, options);
+            } catch (const std::exception& e) {
+                answers[i] = batch[i] + ": error: " + e.what() + "\n";
+            }
+            stats.latencies[first + i] = millisecondsSince(start);
+        }
+        for (const std::string& answer : answers) out << answer;
+        out.flush();
+        stats.seconds += millisecondsSince(start) / 1000;
+        stats.queries += batch.size();
+        stats.batches++;
+    }
+    return stats;
+}
+
+void serveSocket(const QGramIndex& index, const std::string& path, const std::vector<std::string>& names,
+                 const ServeOptions& options, std::ostream& log, const size_t connections) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Invalid socket path '" + path + "'!");
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const FileDescriptor server(::socket(AF_UNIX, SOCK_STREAM, 0));
+    if (server.fd < 0) throw std::runtime_error("Cannot create a socket!");
+    ::unlink(path.c_str());
+    if (::bind(server.fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || ::listen(server.fd, 16) < 0) {
+        throw std::runtime_error("Cannot listen on '" + path + "': " + std::strerror(errno));
+    }
+    for (size_t served = 0; connections == 0 || served < connections;) {
+        const FileDescriptor client(::accept(server.fd, nullptr, nullptr));
+        if (client.fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            throw std::runtime_error(std::string("Cannot accept connections: ") + std::strerror(errno));
+        }
+        SocketBuf buffer(client.fd);
+        std::istream in(&buffer);
+        std::ostream out(&buffer);
+        const ServeStats stats = serveQueries(index, in, out, names, options);
+        log << "connection " << ++served << ": ";
+        stats.print(log);
+    }
+    ::unlink(path.c_str());
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "QGramIndex.hpp"
+
+/// How queries are answered (see answerQuery() and serveQueries())
+struct ServeOptions
+{
+  size_t batch_size = 4096; ///< at most this many queries are answered in parallel at a time
+  bool print_hits = false;  ///< print every hit as <record><TAB><offset> (approximate: plus <TAB><length><TAB><errors>)
+  int max_errors = -1;      ///< >= 0: approximate search with up to this many errors (see QGramIndex::findApproximate())
+  bool hamming = false;     ///< approximate search: mismatches only
+};
+
+/// Throughput and latency of a stream of queries (see serveQueries())
+struct ServeStats
+{
+  size_t queries = 0;
+  size_t batches = 0;
+  double seconds = 0;              ///< wall time from the first query read to the last answer written
+  std::vector<double> latencies;   ///< per query in ms: from its batch being read to its answer being ready
+
+  /// Latency at percentile @p p (0 to 100, nearest rank) in ms; 0 without queries
+  double percentile(const double p) const;
+
+  /// One line: queries, batches, queries per second and latency percentiles (p50, p90, p99, max)
+  void print(std::ostream& out) const;
+};
+
+/**
+  @brief The answer to one query as printed by qg_main: "<query>: <length> <number of hits>", then one line per
+  hit with ServeOptions::print_hits (hits are resolved to @p names, or "#<record id>" beyond them).
+  @throws std::invalid_argument as QGramIndex::find() or QGramIndex::findApproximate()
+*/
+std::string answerQuery(const QGramIndex& index, const std::string& query, const std::vector<std::string>& names,
+                        const ServeOptions& options);
+
+/**
+  @brief Answer the queries of @p in (one per line; blank lines are skipped) until end of input.
+
+  Queries are collected into batches and every batch is answered in parallel (OpenMP worker threads), its answers
+  are written in input order and @p out is flushed. A batch ends at ServeOptions::batch_size queries or as soon as
+  no further input is buffered, so interactive clients get their answers right away while piped input is answered
+  in full batches. A query that cannot be answered yields "<query>: error: <reason>" instead.
+*/
+ServeStats serveQueries(const QGramIndex& index, std::istream& in, std::ostream& out,
+                        const std::vector<std::string>& names, const ServeOptions& options);
+
+/**
+  @brief Listen on the Unix domain socket @p path (an existing file there is replaced) and serve every connection
+  as a query stream (serveQueries()), one connection after another. The statistics of every connection go to @p log.
+  @param connections Return after this many connections (0: serve forever)
+  @throws std::runtime_error if the socket cannot be created
+*/
+void serveSocket(const QGramIndex& index, const std::string& path, const std::vector<std::string>& names,
+                 const ServeOptions& options, std::ostream& log, const size_t connections = 0);
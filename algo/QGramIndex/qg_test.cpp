@@ -4,13 +4,29 @@
 #include <fstream>
 #include <string>
 #include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
 #include <condition_variable>
 #include <thread>
 #include <chrono>
 #include <omp.h>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "QGramIndex.hpp"
 #include "qg_util.hpp"
+#include "qg_fasta.hpp"
+#include "Minimizer.hpp"
+#include "KmerCounter.hpp"
+#include "CompressedQGramIndex.hpp"
+#include "IncrementalQGramIndex.hpp"
+#include "PackedText.hpp"
+#include "qg_server.hpp"
+#include "DeBruijnGraph.hpp"
 
 using namespace std;
 
@@ -236,9 +252,6 @@ TRT test_BONUS(const string& filename)
   }
   //std::cin >> d;
   // test results are equal:
-  // sort hits since partial cumulative sum leads to different orders (usually its reversed)
-  std::cout << "Sorting hits (" << h2.size() << ")\n";
-  sort(h2.begin(), h2.end(), std::greater<uint32_t>());
   bool eq = (h1 == h2);
   std::cout << (eq ? "Results equal" : "Results differ :/");
 
@@ -252,6 +265,1405 @@ TRT test_BONUS(const string& filename)
 }
 
 
+TRT test_parallel_build()
+{
+  // construction must give the identical index for any number of threads
+  int cases = 0;
+  string text(200000, 'A');
+  srand(42);
+  for (auto& c : text) c = "ACGT"[rand() % 4];
+  for (uint8_t q : {1, 4, 7})
+  {
+    omp_set_num_threads(1);
+    QGramIndex seq(text, q);
+    omp_set_num_threads(4);
+    QGramIndex par(text, q);
+    bool eq = true, descending = true;
+    uint32_t total = 0;
+    for (uint32_t h = 0; h < (1u << 2*q); ++h)
+    {
+      auto r = par.getHits(h);
+      eq &= (r == seq.getHits(h));
+      descending &= std::is_sorted(r.rbegin(), r.rend());
+      total += r.size();
+    }
+    if (eq && descending && total == text.size() - q + 1) ++cases;
+    else std::cout << "q=" << (int)q << ": parallel index differs\n";
+  }
+  omp_set_num_threads(1);
+
+  // text shorter than q: empty index
+  QGramIndex tiny("ACG", 4);
+  if (tiny.getHits(tiny.hash("ACGT")).empty()) ++cases;
+
+  return make_pair(cases == 4 ? 2 : 0, 2);
+}
+
+TRT test_sparse()
+{
+  int cases = 0;
+  string text(100000, 'A');
+  srand(7);
+  for (auto& c : text) c = "ACGT"[rand() % 4];
+  text += text.substr(5000, 3000); // some repeats for long q-grams
+  QGramOptions sparse;
+  sparse.sparse = true;
+
+  // same hits (and order) as the dense directory
+  bool eq = true;
+  for (uint8_t q : {1, 5, 11})
+  {
+    QGramIndex dense(text, q);
+    QGramIndex sp(text, q, sparse);
+    for (uint32_t h = 0; h < (1u << 2*q); ++h) eq &= (sp.getHits(h) == dense.getHits(h));
+    eq &= (sp.distinctQGrams() == dense.distinctQGrams());
+  }
+  if (eq) ++cases;
+
+  // long q-grams against a naive scan
+  eq = true;
+  for (uint8_t q : {21, 31, 32})
+  {
+    QGramIndex sp(text, q, sparse);
+    std::set<string> distinct;
+    for (size_t i = 0; i + q <= text.size(); ++i) distinct.insert(text.substr(i, q));
+    eq &= (sp.distinctQGrams() == distinct.size());
+    for (size_t probe : {size_t(0), size_t(5100), text.size() - q})
+    {
+      const string qgram = text.substr(probe, q);
+      std::vector<uint32_t> expected;
+      for (size_t i = text.size() - q + 1; i-- > 0;) if (text.compare(i, q, qgram) == 0) expected.push_back(i);
+      eq &= (sp.getHits64(sp.hash64(qgram)) == expected);
+    }
+    eq &= sp.getHits64(sp.hash64(string(q, 'T'))).empty();
+  }
+  if (eq) ++cases;
+
+  // range checks
+  try { QGramIndex bad(text, 33, sparse); }
+  catch (std::invalid_argument&) { ++cases; }
+  try { QGramIndex sp(text, 20, sparse); sp.hash(string(20, 'A')); }
+  catch (std::invalid_argument&) { ++cases; }
+  {
+    QGramIndex sp(text, 12, sparse);
+    try { sp.getHits64(uint64_t(1) << 24); }
+    catch (std::invalid_argument&) { ++cases; }
+  }
+
+  return make_pair(cases == 5 ? 2 : 0, 2);
+}
+
+TRT test_save_load()
+{
+  int cases = 0;
+  string text(50000, 'A');
+  srand(11);
+  for (auto& c : text) c = "ACGT"[rand() % 4];
+  const string file = "qg_test.idx";
+
+  // dense: all hits survive the round trip, also after moving the loaded index
+  {
+    QGramIndex built(text, 7);
+    built.save(file);
+    QGramIndex loaded = QGramIndex::load(file);
+    QGramIndex moved(std::move(loaded));
+    bool eq = (moved.getQ() == 7) && !moved.isSparse() && (moved.getText() == text) && (moved.getTextView() == text);
+    for (uint32_t h = 0; h < (1u << 14); ++h) eq &= (moved.getHits(h) == built.getHits(h));
+    if (eq) ++cases;
+  }
+  // sparse
+  {
+    QGramOptions sparse;
+    sparse.sparse = true;
+    QGramIndex built(text, 25, sparse);
+    built.save(file);
+    QGramIndex loaded = QGramIndex::load(file);
+    bool eq = loaded.isSparse() && (loaded.distinctQGrams() == built.distinctQGrams());
+    for (size_t i = 0; i + 25 <= text.size(); i += 997)
+    {
+      const uint64_t h = built.hash64(text.substr(i, 25));
+      eq &= (loaded.getHits64(h) == built.getHits64(h));
+    }
+    if (eq) ++cases;
+  }
+  // broken files
+  {
+    std::fstream f(file, std::ios::in | std::ios::out | std::ios::binary);
+    f.write("XXXX", 4);
+  }
+  try { QGramIndex::load(file); }
+  catch (std::runtime_error&) { ++cases; }
+  try { QGramIndex::load(file + ".missing"); }
+  catch (std::runtime_error&) { ++cases; }
+  std::remove(file.c_str());
+
+  return make_pair(cases == 4 ? 2 : 0, 2);
+}
+
+TRT test_records()
+{
+  int cases = 0;
+  std::istringstream fasta(">r1 first\nACGTAC\nGT\n>r2\r\nACGTTT\n>empty\n>r3\nACG\n>r4\nTTACGTACGTAACG\n");
+  FastaRecords recs = readFasta(fasta);
+  if (recs.text == "ACGTACGTACGTTTACGTTACGTACGTAACG" && recs.names == std::vector<string>({"r1", "r2", "empty", "r3", "r4"})
+      && recs.starts == std::vector<uint32_t>({0, 8, 14, 14, 17})) ++cases;
+
+  // no q-gram spans two records; compare with a naive search per record (dense, sparse, 1 and 4 threads)
+  QGramOptions sparse;
+  sparse.sparse = true;
+  bool eq = true;
+  for (uint8_t q : {2, 3, 5})
+  {
+    for (int threads : {1, 4})
+    {
+      omp_set_num_threads(threads);
+      QGramIndex dense(recs.text, recs.starts, q);
+      QGramIndex sp(recs.text, recs.starts, q, sparse);
+      for (uint32_t h = 0; h < (1u << 2*q); ++h)
+      {
+        string qgram;
+        for (int i = q - 1; i >= 0; --i) qgram += dna((h >> 2*i) & 3);
+        std::vector<std::pair<uint32_t, uint32_t>> expected, got;
+        for (size_t r = recs.names.size(); r-- > 0;)
+        {
+          const size_t end = (r + 1 < recs.starts.size()) ? recs.starts[r + 1] : recs.text.size();
+          for (size_t i = end; i-- > recs.starts[r];)
+            if (i + q <= end && recs.text.compare(i, q, qgram) == 0) expected.emplace_back(r, i - recs.starts[r]);
+        }
+        for (uint32_t hit : dense.getHits(h)) got.push_back(dense.resolve(hit));
+        eq &= (got == expected) && (sp.getHits(h) == dense.getHits(h));
+      }
+    }
+  }
+  // many records, long enough for the parallel build (chunks start in the middle of records)
+  string text;
+  std::vector<uint32_t> starts;
+  srand(3);
+  for (int r = 0; r < 500; ++r)
+  {
+    starts.push_back(text.size());
+    for (int i = rand() % 400; i > 0; --i) text += "ACGT"[rand() % 4];
+  }
+  omp_set_num_threads(1);
+  QGramIndex seq(text, starts, 3);
+  omp_set_num_threads(4);
+  QGramIndex par(text, starts, 3);
+  for (uint32_t h = 0; h < 64; ++h) eq &= (seq.getHits(h) == par.getHits(h));
+  omp_set_num_threads(1);
+  if (eq) ++cases;
+
+  // the record table survives save/load
+  {
+    QGramIndex built(recs.text, recs.starts, 4);
+    built.save("qg_test.idx");
+    QGramIndex loaded = QGramIndex::load("qg_test.idx");
+    std::remove("qg_test.idx");
+    if (loaded.getRecordCount() == 5 && loaded.resolve(30) == std::make_pair(4u, 13u)
+        && loaded.getHits(loaded.hash("GTAC")) == built.getHits(built.hash("GTAC"))) ++cases;
+  }
+
+  try { QGramIndex bad(recs.text, std::vector<uint32_t>({0, 9, 8}), 3); }
+  catch (std::invalid_argument&) { ++cases; }
+  try { QGramIndex bad(recs.text, std::vector<uint32_t>({1, 9}), 3); }
+  catch (std::invalid_argument&) { ++cases; }
+
+  return make_pair(cases == 5 ? 2 : 0, 2);
+}
+
+/// (w,q)-minimizer positions of every record, by brute force (leftmost smallest minimizerOrder() per window)
+std::set<uint32_t> naiveMinimizers(const string& text, const std::vector<uint32_t>& starts, uint8_t q, uint32_t w)
+{
+  RollingHash rolling(q);
+  std::set<uint32_t> result;
+  for (size_t r = 0; r < starts.size(); ++r)
+  {
+    const size_t end = (r + 1 < starts.size()) ? starts[r + 1] : text.size();
+    if (end - starts[r] < q) continue;
+    const size_t qgrams = end - starts[r] - q + 1;
+    for (size_t win = 0; win + std::min<size_t>(w, qgrams) <= qgrams; ++win)
+    {
+      size_t best = starts[r] + win;
+      for (size_t i = best; i < starts[r] + win + std::min<size_t>(w, qgrams); ++i)
+        if (minimizerOrder(rolling.hash(&text[i])) < minimizerOrder(rolling.hash(&text[best]))) best = i;
+      result.insert(best);
+    }
+  }
+  return result;
+}
+
+TRT test_minimizers()
+{
+  int cases = 0;
+  string text;
+  std::vector<uint32_t> starts;
+  srand(5);
+  for (int r = 0; r < 40; ++r)
+  {
+    starts.push_back(text.size());
+    for (int i = (r % 10 == 0) ? rand() % 8 : rand() % 3000; i > 0; --i) text += "ACGT"[rand() % 4];
+  }
+  text += string(500, 'A'); // low complexity tail
+
+  bool eq = true;
+  for (auto [q, w, sparse] : {std::make_tuple(5, 10u, false), std::make_tuple(15, 10u, true), std::make_tuple(8, 3u, false)})
+  {
+    QGramOptions options;
+    options.sparse = sparse;
+    options.window = w;
+    const std::set<uint32_t> expected = naiveMinimizers(text, starts, q, w);
+    omp_set_num_threads(1);
+    QGramIndex seq(text, starts, q, options);
+    omp_set_num_threads(4);
+    QGramIndex par(text, starts, q, options);
+    omp_set_num_threads(1);
+    std::set<uint32_t> got;
+    for (const auto& kv : expected)
+    {
+      const uint64_t h = seq.hash64(text.substr(kv, q));
+      const auto hits = seq.getHits64(h);
+      eq &= (hits == par.getHits64(h));
+      got.insert(hits.begin(), hits.end());
+    }
+    eq &= (got == expected);
+  }
+  if (eq) ++cases;
+
+  // density ~ 2/(w+1) on random text
+  {
+    QGramOptions options;
+    options.window = 10;
+    QGramIndex idx(text, 12, options);
+    std::vector<std::pair<uint32_t, uint64_t>> mins;
+    idx.getMinimizers(text, mins);
+    const double density = double(mins.size()) / text.size();
+    std::cout << "minimizer density: " << density << " (expected ~" << 2.0 / 11 << ")\n";
+    if (density > 0.15 && density < 0.22 && idx.getWindow() == 10) ++cases;
+    // every minimizer of a query is a minimizer of its occurrence, too
+    const string query = text.substr(10000, 200);
+    idx.getMinimizers(query, mins);
+    bool found = !mins.empty();
+    for (auto [offset, h] : mins)
+    {
+      const auto hits = idx.getHits64(h);
+      found &= std::find(hits.begin(), hits.end(), 10000 + offset) != hits.end();
+    }
+    if (found) ++cases;
+
+    idx.save("qg_test.idx");
+    QGramIndex loaded = QGramIndex::load("qg_test.idx");
+    std::remove("qg_test.idx");
+    if (loaded.getWindow() == 10 && loaded.getHits64(mins[0].second) == idx.getHits64(mins[0].second)) ++cases;
+  }
+
+  return make_pair(cases == 4 ? 2 : 0, 2);
+}
+
+TRT test_find()
+{
+  int cases = 0;
+  string text;
+  std::vector<uint32_t> starts;
+  srand(9);
+  for (int r = 0; r < 30; ++r)
+  {
+    starts.push_back(text.size());
+    for (int i = rand() % 2000; i > 0; --i) text += "ACGT"[rand() % 4];
+    text += "GATTACAGATTACA"; // at the end of every record
+  }
+  const auto naive = [&](const string& pattern) {
+    std::vector<uint32_t> result;
+    for (size_t r = 0; r < starts.size(); ++r)
+    {
+      const size_t end = (r + 1 < starts.size()) ? starts[r + 1] : text.size();
+      for (size_t i = starts[r]; i + pattern.size() <= end; ++i)
+        if (text.compare(i, pattern.size(), pattern) == 0) result.push_back(i);
+    }
+    return result;
+  };
+
+  QGramOptions sparse;
+  sparse.sparse = true;
+  QGramOptions minimizer;
+  minimizer.window = 5;
+  const QGramIndex dense(text, starts, 6);
+  const QGramIndex sp(text, starts, 20, sparse);
+  const QGramIndex mini(text, starts, 6, minimizer);
+  std::vector<string> patterns = {"A", "GA", "TTACA", "GATTAC", "GATTACAGATTACA", "ACAGATT", "ACGTACGTACGTACGTACGTACGT"};
+  for (int i = 0; i < 50; ++i)
+  {
+    const size_t len = 1 + rand() % 40;
+    patterns.push_back(text.substr(rand() % (text.size() - len), len));
+  }
+  bool eq = true;
+  for (const string& p : patterns)
+  {
+    const auto expected = naive(p);
+    eq &= (dense.find(p) == expected);
+    eq &= (sp.find(p) == expected);
+    if (p.size() >= 6 + 5 - 1) eq &= (mini.find(p) == expected);
+    if (!eq) { std::cout << "find('" << p << "') differs\n"; break; }
+  }
+  if (eq) ++cases;
+
+  // case-insensitive, like the hashes: lowercase patterns, a soft-masked (lowercase) text, on the packed text and,
+  // with an N in the text, character by character; N never matches
+  {
+    const string plain = "ACGTACGTTTGACGTAAC", masked = "acgtACGTttgacgtaac", masked_n = masked + "NACGT";
+    const QGramIndex upper(plain, 3), lower(masked, 3), with_n(masked_n, 3);
+    const std::vector<uint32_t> expected = {0, 4, 11};
+    if (upper.find("acgt") == expected && upper.find("AcGt") == expected && lower.find("ACGT") == expected
+        && lower.find("ac") == std::vector<uint32_t>{0, 4, 11, 16} && with_n.find("acgt") == std::vector<uint32_t>{0, 4, 11, 19}
+        && with_n.find("CNA").empty() && with_n.find("cna").empty()) ++cases;
+  }
+
+  try { dense.find(""); }
+  catch (std::invalid_argument&) { ++cases; }
+  try { mini.find("GATTACA"); } // shorter than one minimizer window
+  catch (std::invalid_argument&) { ++cases; }
+
+  return make_pair(cases == 4 ? 2 : 0, 2);
+}
+
+TRT test_hits_view()
+{
+  int cases = 0;
+  string text(100000, 'A');
+  srand(13);
+  for (auto& c : text) c = "ACGT"[rand() % 4];
+  QGramOptions sparse;
+  sparse.sparse = true;
+  for (const QGramOptions& options : {QGramOptions(), sparse})
+  {
+    const QGramIndex idx(text, 9, options);
+    std::vector<uint64_t> hashes;
+    for (int i = 0; i < 5000; ++i) hashes.push_back(uint64_t(rand()) % (1u << 18));
+    std::vector<ArrayView<uint32_t>> views;
+    idx.getHitsBatch(hashes, views);
+    bool eq = (views.size() == hashes.size());
+    for (size_t i = 0; eq && i < hashes.size(); ++i)
+    {
+      const ArrayView<uint32_t> single = idx.getHitsView(hashes[i]);
+      const std::vector<uint32_t> copy = idx.getHits64(hashes[i]);
+      eq &= std::equal(single.begin(), single.end(), copy.begin(), copy.end());
+      eq &= (views[i].data() == single.data() || views[i].empty()) && views[i].size() == copy.size();
+    }
+    try { idx.getHitsView(uint64_t(1) << 18); eq = false; }
+    catch (std::invalid_argument&) {}
+    if (eq) ++cases;
+  }
+  return make_pair(cases == 2 ? 2 : 0, 2);
+}
+
+TRT test_canonical()
+{
+  int cases = 0;
+  srand(17);
+  // rolling reverse complement hash
+  bool eq = true;
+  for (uint8_t q : {1, 5, 16, 31, 32})
+  {
+    RollingHash rolling(q);
+    string s(200, 'A');
+    for (auto& c : s) c = "ACGT"[rand() % 4];
+    uint64_t rc = rolling.hashRC(s.data());
+    for (size_t i = 0; i + q <= s.size(); ++i)
+    {
+      if (i > 0) rc = rolling.nextRC(rc, s[i + q - 1]);
+      const string qgram = s.substr(i, q);
+      eq &= (rc == rolling.hash(reverseComplement(qgram).data())) && (rc == rolling.reverseComplement(rolling.hash(qgram.data())));
+    }
+  }
+  if (eq) ++cases;
+
+  string text;
+  std::vector<uint32_t> starts;
+  for (int r = 0; r < 20; ++r)
+  {
+    starts.push_back(text.size());
+    for (int i = rand() % 3000; i > 0; --i) text += "ACGT"[rand() % 4];
+    for (int i = 40; i > 0; --i) text += "ACGT"[rand() % 4];
+    text += "ACGTTGCA" + reverseComplement(text.substr(text.size() - 40, 30)); // palindrome + inverted repeat
+  }
+  const auto naive = [&](const string& pattern, uint32_t flag, std::vector<uint32_t>& result) {
+    for (size_t r = 0; r < starts.size(); ++r)
+    {
+      const size_t end = (r + 1 < starts.size()) ? starts[r + 1] : text.size();
+      for (size_t i = starts[r]; i + pattern.size() <= end; ++i)
+        if (text.compare(i, pattern.size(), pattern) == 0) result.push_back(i | flag);
+    }
+  };
+
+  // hits of a q-gram: both strands in one bucket, marked by STRAND_BIT
+  eq = true;
+  QGramOptions canonical;
+  canonical.canonical = true;
+  QGramOptions sparse = canonical;
+  sparse.sparse = true;
+  QGramOptions mini = canonical;
+  mini.window = 5;
+  for (auto [q, options] : {std::make_pair(7, canonical), std::make_pair(21, sparse), std::make_pair(11, mini)})
+  {
+    omp_set_num_threads(4);
+    QGramIndex par(text, starts, q, options);
+    omp_set_num_threads(1);
+    QGramIndex idx(text, starts, q, options);
+    eq &= idx.isCanonical();
+    for (int probe = 0; probe < 50; ++probe)
+    {
+      const string qgram = (probe == 0) ? string("ACGTTGCA").substr(0, std::min(q, 8)) + string(std::max(0, q - 8), 'A')
+                                        : text.substr(rand() % (text.size() - q), q);
+      std::vector<uint32_t> hits = idx.getHits64(idx.hash64(qgram));
+      eq &= (hits == par.getHits64(par.hash64(reverseComplement(qgram))));
+      if (options.window > 1) continue; // sampled
+      const string rc = reverseComplement(qgram);
+      const bool reverse = rc < qgram; // the key is the lexicographically smaller strand
+      std::vector<uint32_t> expected;
+      naive(qgram, reverse ? QGramIndex::STRAND_BIT : 0, expected);
+      if (rc != qgram) naive(rc, reverse ? 0 : QGramIndex::STRAND_BIT, expected);
+      std::sort(hits.begin(), hits.end());
+      std::sort(expected.begin(), expected.end());
+      eq &= (hits == expected);
+    }
+  }
+  if (eq) ++cases;
+
+  // find on both strands: canonical (one lookup) == plain index (two lookups) == naive
+  eq = true;
+  QGramIndex plain(text, starts, 9);
+  QGramIndex canon(text, starts, 9, canonical);
+  QGramIndex canon_mini(text, starts, 9, mini);
+  for (int probe = 0; probe < 60; ++probe)
+  {
+    const size_t len = 13 + rand() % 30;
+    string pattern = text.substr(rand() % (text.size() - len), len);
+    if (probe % 3 == 0) pattern = reverseComplement(pattern);
+    if (probe == 0) pattern = "ACGTTGCAACGTTGCA";
+    std::vector<uint32_t> expected;
+    naive(pattern, 0, expected);
+    naive(reverseComplement(pattern), QGramIndex::STRAND_BIT, expected);
+    std::sort(expected.begin(), expected.end(), [](uint32_t a, uint32_t b) {
+      return std::make_pair(QGramIndex::hitPosition(a), a) < std::make_pair(QGramIndex::hitPosition(b), b); });
+    eq &= (plain.find(pattern, true) == expected) && (canon.find(pattern, true) == expected) && (canon_mini.find(pattern, true) == expected);
+    std::vector<uint32_t> forward;
+    naive(pattern, 0, forward);
+    eq &= (canon.find(pattern) == forward);
+    if (!eq) { std::cout << "find('" << pattern << "', true) differs\n"; break; }
+  }
+  if (eq) ++cases;
+
+  // round trip
+  canon.save("qg_test.idx");
+  QGramIndex loaded = QGramIndex::load("qg_test.idx");
+  std::remove("qg_test.idx");
+  if (loaded.isCanonical() && loaded.find("ACGTTGCAACGT", true) == canon.find("ACGTTGCAACGT", true)) ++cases;
+
+  return make_pair(cases == 4 ? 2 : 0, 2);
+}
+
+TRT test_kmer_counter()
+{
+  // counts must equal a naive count, for either strand mode, any number of threads and batch size
+  int cases = 0;
+  srand(41);
+  string genome(3000, 'A');
+  for (auto& c : genome) c = "ACGT"[rand() % 4];
+  std::ostringstream fastq;
+  std::vector<string> reads;
+  for (int i = 0; i < 400; ++i)
+  {
+    string read = genome.substr(rand() % (genome.size() - 80), 20 + rand() % 60);
+    if (i % 7 == 0) read[rand() % read.size()] = 'N';
+    if (i % 2 == 0) read = reverseComplement(read);
+    reads.push_back(read);
+    fastq << "@read" << i << "\n" << read << "\n+\n" << string(read.size(), 'I') << "\n";
+  }
+  const uint8_t k = 15;
+  RollingHash rolling(k);
+  for (bool canonical : {false, true})
+  {
+    std::map<uint64_t, uint32_t> naive;
+    uint64_t total = 0;
+    for (const auto& read : reads)
+    {
+      for (size_t i = 0; i + k <= read.size(); ++i)
+      {
+        const string kmer = read.substr(i, k);
+        if (kmer.find('N') != string::npos) continue;
+        const uint64_t h = rolling.hash(kmer.data());
+        ++naive[canonical ? std::min(h, rolling.hashRC(kmer.data())) : h];
+        ++total;
+      }
+    }
+    KmerOptions options;
+    options.canonical = canonical;
+    options.partition_bits = 3;
+    options.batch_size = 7;
+    KmerCounter streamed(k, options);
+    std::istringstream input(fastq.str());
+    const size_t read_count = streamed.count(input);
+    omp_set_num_threads(4);
+    KmerCounter batched(k, options);
+    batched.add(reads);
+    batched.flush();
+    omp_set_num_threads(1);
+
+    std::vector<std::pair<uint64_t, uint32_t>> a, b;
+    streamed.forEach([&a](uint64_t h, uint32_t c) { a.emplace_back(h, c); });
+    batched.forEach([&b](uint64_t h, uint32_t c) { b.emplace_back(h, c); });
+    const std::vector<std::pair<uint64_t, uint32_t>> expected(naive.begin(), naive.end());
+    bool eq = read_count == reads.size() && a == expected && b == expected && streamed.total() == total;
+    const string kmer = reads[1].substr(0, k);
+    eq &= streamed.count(kmer) == naive[canonical ? std::min(rolling.hash(kmer.data()), rolling.hashRC(kmer.data())) : rolling.hash(kmer.data())];
+    eq &= streamed.count(reverseComplement(kmer)) == (canonical ? streamed.count(kmer) : naive[rolling.hashRC(kmer.data())]);
+    auto histogram = streamed.histogram(5);
+    uint64_t distinct = 0;
+    for (auto n : histogram) distinct += n;
+    eq &= distinct == naive.size() && histogram[0] == 0;
+    if (eq) ++cases;
+    else std::cout << "canonical=" << canonical << ": k-mer counts differ\n";
+  }
+
+  // round trip through the binary table
+  KmerCounter counter(k);
+  counter.add(reads);
+  counter.flush();
+  counter.save("qg_test.kc");
+  KmerCounter loaded = KmerCounter::load("qg_test.kc");
+  std::remove("qg_test.kc");
+  std::vector<std::pair<uint64_t, uint32_t>> a, b;
+  counter.forEach([&a](uint64_t h, uint32_t c) { a.emplace_back(h, c); });
+  loaded.forEach([&b](uint64_t h, uint32_t c) { b.emplace_back(h, c); });
+  if (a == b && loaded.isCanonical() && loaded.getK() == k && loaded.total() == counter.total()) ++cases;
+
+  // genome size of an ideal spectrum: 1000 error k-mers, 5000 k-mers around coverage 20
+  std::vector<uint64_t> spectrum(40, 0);
+  spectrum[1] = 1000; spectrum[2] = 100;
+  spectrum[19] = 1000; spectrum[20] = 3000; spectrum[21] = 1000;
+  if (estimateGenomeSize(spectrum) == 5000) ++cases;
+
+  return make_pair(cases == 4 ? 2 : 0, 2);
+}
+
+TRT test_compressed()
+{
+  // hits must equal those of the uncompressed index, for every directory variant
+  int cases = 0;
+  srand(43);
+  string text(300000, 'A');
+  for (auto& c : text) c = "ACGT"[rand() % 4];
+  text.replace(1000, 500, string(500, 'A')); // one huge bucket
+  const std::vector<uint32_t> starts = {0, 70000, 70001, 150000};
+
+  QGramOptions sparse_canonical;
+  sparse_canonical.sparse = true;
+  sparse_canonical.canonical = true;
+  QGramOptions mini;
+  mini.sparse = true;
+  mini.window = 5;
+  const std::vector<std::pair<uint8_t, QGramOptions>> variants = {{6, QGramOptions()}, {20, sparse_canonical}, {15, mini}};
+  for (const auto& [q, options] : variants)
+  {
+    QGramIndex plain(text, starts, q, options);
+    CompressedQGramIndex packed(text, starts, q, options);
+    RollingHash rolling(q);
+    bool eq = packed.getQ() == q && packed.isSparse() == options.sparse && packed.isCanonical() == options.canonical;
+    for (int probe = 0; probe < 2000 && eq; ++probe)
+    {
+      const uint64_t h = (probe % 4 == 0) ? (uint64_t(rand()) * rand()) & rolling.maxHash()
+                                          : rolling.hash(text.data() + rand() % (text.size() - q));
+      eq &= packed.getHits64(h) == plain.getHits64(h) && packed.countHits(h) == plain.getHitsView(h).size();
+    }
+    eq &= packed.getHits64(0) == plain.getHits64(0) && packed.getHits64(rolling.maxHash()) == plain.getHits64(rolling.maxHash());
+    for (int probe = 0; probe < 50 && eq; ++probe)
+    {
+      const string pattern = text.substr(rand() % (text.size() - 40), 20 + rand() % 20);
+      eq &= packed.find(pattern) == plain.find(pattern);
+    }
+    if (eq) ++cases;
+    else std::cout << "q=" << int(q) << ": compressed index differs\n";
+  }
+
+  // a dense index over a large text shrinks by half at least
+  CompressedQGramIndex packed(text, 6);
+  if (packed.size() == text.size() - 5 && packed.sizeInBytes() * 2 < packed.size() * sizeof(uint32_t)) ++cases;
+  else std::cout << "compressed index: " << packed.sizeInBytes() << " bytes for " << packed.size() << " positions\n";
+
+  // lowercase patterns and a soft-masked text give the hits of QGramIndex::find()
+  {
+    string masked = text.substr(0, 5000);
+    for (size_t i = 1000; i < 3000; ++i) masked[i] = char(tolower(masked[i]));
+    masked[2000] = 'N';
+    const QGramIndex plain_masked(masked, 8);
+    const CompressedQGramIndex packed_masked(masked, 8);
+    bool same = true;
+    for (const size_t pos : {500, 990, 1500, 1990, 2900})
+    {
+      string pattern = text.substr(pos, 20);
+      const std::vector<uint32_t> hits = plain_masked.find(pattern);
+      same &= packed_masked.find(pattern) == hits && (pos == 1990 ? hits.empty() : hits.size() == 1);
+      for (char& c : pattern) c = char(tolower(c));
+      same &= packed_masked.find(pattern) == hits;
+    }
+    if (same) ++cases;
+  }
+
+  bool thrown = false;
+  try { packed.getHits64(1 << 12); } catch (const std::invalid_argument&) { thrown = true; }
+  if (thrown) ++cases;
+
+  return make_pair(cases == 6 ? 2 : 0, 2);
+}
+
+TRT test_incremental()
+{
+  // adding batches must give the same hits as building over all records at once
+  int cases = 0;
+  srand(44);
+  std::vector<std::vector<string>> batches;
+  string all;
+  std::vector<uint32_t> starts;
+  for (int b = 0; b < 40; ++b)
+  {
+    batches.emplace_back();
+    for (int r = 0, n = 1 + rand() % 3; r < n; ++r)
+    {
+      string seq(rand() % 3000, 'A');
+      for (auto& c : seq) c = "ACGT"[rand() % 4];
+      starts.push_back(all.size());
+      all += seq;
+      batches.back().push_back(seq);
+    }
+  }
+
+  QGramOptions sparse_canonical;
+  sparse_canonical.sparse = true;
+  sparse_canonical.canonical = true;
+  QGramOptions dense_canonical;
+  dense_canonical.canonical = true;
+  QGramOptions mini;
+  mini.sparse = true;
+  mini.window = 4;
+  const std::vector<std::pair<uint8_t, QGramOptions>> variants = {{5, QGramOptions()}, {6, dense_canonical}, {17, sparse_canonical}, {14, mini}};
+  for (const auto& [q, options] : variants)
+  {
+    QGramIndex full(all, starts, q, options);
+    IncrementalQGramIndex incremental(q, options, 2);
+    size_t max_segments = 0;
+    for (const auto& batch : batches)
+    {
+      incremental.add(batch);
+      max_segments = std::max(max_segments, incremental.segmentCount());
+    }
+    RollingHash rolling(q);
+    bool eq = incremental.textLength() == all.size() && incremental.getRecordCount() == starts.size() && max_segments <= 8;
+    for (int probe = 0; probe < 1000 && eq; ++probe)
+    {
+      const uint64_t h = rolling.hash(all.data() + rand() % (all.size() - q));
+      eq &= incremental.getHits64(h) == full.getHits64(h);
+    }
+    for (int probe = 0; probe < 30 && eq; ++probe)
+    {
+      const string pattern = all.substr(rand() % (all.size() - 40), 20 + rand() % 20);
+      eq &= incremental.find(pattern, true) == full.find(pattern, true);
+      const uint32_t pos = rand() % all.size();
+      eq &= incremental.resolve(pos) == full.resolve(pos);
+    }
+    incremental.compact();
+    const uint64_t h = rolling.hash(all.data() + 1234);
+    eq &= incremental.segmentCount() == 1 && incremental.getHits64(h) == full.getHits64(h);
+    if (eq) ++cases;
+    else std::cout << "q=" << int(q) << ": incremental index differs\n";
+  }
+
+  // grow a saved base index
+  const string base_text = batches[0][0];
+  {
+    QGramIndex base(base_text, 7);
+    base.save("qg_test.idx");
+  }
+  IncrementalQGramIndex grown(QGramIndex::load("qg_test.idx"));
+  grown.add({"ACGTACGTTT", "GGGACGTACGTCC"});
+  grown.save("qg_test.idx");
+  QGramIndex reloaded = QGramIndex::load("qg_test.idx");
+  std::remove("qg_test.idx");
+  const string grown_text = base_text + "ACGTACGTTT" + "GGGACGTACGTCC";
+  QGramIndex expected(grown_text, {0, uint32_t(base_text.size()), uint32_t(base_text.size() + 10)}, 7);
+  if (reloaded.getRecordCount() == 3 && reloaded.getTextView() == grown_text
+      && reloaded.getHits(reloaded.hash("ACGTACG")) == expected.getHits(expected.hash("ACGTACG"))) ++cases;
+
+  // a delta of a dense base is sparse: a read costs about its own size, not another 4^q directory
+  {
+    QGramIndex dense_base(all, starts, 11);
+    const size_t base_bytes = dense_base.sizeInBytes();
+    IncrementalQGramIndex growing(std::move(dense_base));
+    growing.add({"ACGTACGTACGTACGT"});
+    const bool small = growing.segmentCount() == 2 && growing.sizeInBytes() < base_bytes + 4096;
+    growing.compact();
+    if (small && growing.sizeInBytes() >= base_bytes && growing.find("ACGTACGTACGTACGT").back() == all.size()) ++cases;
+    else std::cout << "delta segment: " << growing.sizeInBytes() << " bytes, base " << base_bytes << "\n";
+  }
+
+  // merging requires the concatenated text
+  bool thrown = false;
+  const string text_a = "ACGTACGT", text_b = "TTTT";
+  QGramIndex a(text_a, 3), b(text_b, 3);
+  string wrong = "ACGTACGTTTTA";
+  try { QGramIndex::merge(wrong, a, b); } catch (const std::invalid_argument&) { thrown = true; }
+  if (thrown) ++cases;
+
+  return make_pair(cases == 7 ? 2 : 0, 2);
+}
+
+/// Edit distance of a and b (global)
+static uint32_t editDistance(const string& a, const string& b)
+{
+  std::vector<uint32_t> row(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); ++j) row[j] = j;
+  for (size_t i = 1; i <= a.size(); ++i)
+  {
+    uint32_t diagonal = row[0];
+    row[0] = i;
+    for (size_t j = 1; j <= b.size(); ++j)
+    {
+      const uint32_t up = row[j];
+      row[j] = std::min({up + 1, row[j-1] + 1, diagonal + (a[i-1] != b[j-1])});
+      diagonal = up;
+    }
+  }
+  return row[b.size()];
+}
+
+/// (end, errors) of all approximate occurrences with <= k errors within one record, by full DP (Sellers)
+static std::vector<std::pair<uint32_t, uint32_t>> naiveApproximate(const string& text, const std::vector<uint32_t>& starts,
+                                                                   const string& pattern, uint32_t k, bool mismatches_only)
+{
+  std::vector<std::pair<uint32_t, uint32_t>> result;
+  const size_t m = pattern.size();
+  for (size_t r = 0; r < starts.size(); ++r)
+  {
+    const size_t begin = starts[r], end = (r + 1 < starts.size()) ? starts[r+1] : text.size();
+    if (mismatches_only)
+    {
+      for (size_t s = begin; s + m <= end; ++s)
+      {
+        uint32_t mm = 0;
+        for (size_t i = 0; i < m; ++i) mm += !sameBase(pattern[i], text[s + i]);
+        if (mm <= k) result.emplace_back(s + m, mm);
+      }
+      continue;
+    }
+    std::vector<uint32_t> column(m + 1);
+    for (size_t i = 0; i <= m; ++i) column[i] = i;
+    if (column[m] <= k) result.emplace_back(begin, column[m]);
+    for (size_t c = begin; c < end; ++c)
+    {
+      uint32_t diagonal = 0; // row 0 is free
+      for (size_t i = 1; i <= m; ++i)
+      {
+        const uint32_t left = column[i];
+        column[i] = std::min({left + 1, column[i-1] + 1, diagonal + !sameBase(pattern[i-1], text[c])});
+        diagonal = left;
+      }
+      if (column[m] <= k) result.emplace_back(c + 1, column[m]);
+    }
+  }
+  return result;
+}
+
+TRT test_approximate()
+{
+  // the filter must be lossless: every end found by a full DP is reported, with the same number of errors
+  int cases = 0;
+  srand(45);
+  string text(20000, 'A');
+  for (auto& c : text) c = "ACGT"[rand() % 4];
+  const std::vector<uint32_t> starts = {0, 5000, 5003, 12000};
+  // plant mutated copies of a few patterns
+  std::vector<string> patterns;
+  for (int p = 0; p < 12; ++p)
+  {
+    string pattern(24 + rand() % 16, 'A');
+    for (auto& c : pattern) c = "ACGT"[rand() % 4];
+    for (int copy = 0; copy < 4; ++copy)
+    {
+      string mutated = pattern;
+      for (int e = rand() % 4; e > 0; --e)
+      {
+        const size_t at = rand() % mutated.size();
+        const int kind = (p % 3 == 0) ? 0 : rand() % 3;
+        if (kind == 0) mutated[at] = "ACGT"[rand() % 4];
+        else if (kind == 1) mutated.insert(mutated.begin() + at, "ACGT"[rand() % 4]);
+        else mutated.erase(at, 1);
+      }
+      text.replace(rand() % (text.size() - mutated.size()), mutated.size(), mutated);
+    }
+    patterns.push_back(pattern);
+  }
+  patterns.push_back(text.substr(4990, 30)); // occurrence across a record boundary must not be found
+
+  QGramOptions sparse_canonical;
+  sparse_canonical.sparse = true;
+  sparse_canonical.canonical = true;
+  QGramIndex dense(text, starts, 4);
+  QGramIndex sparse(text, starts, 5, sparse_canonical);
+  bool edit_ok = true, hamming_ok = true, begin_ok = true;
+  for (size_t p = 0; p < patterns.size(); ++p)
+  {
+    const string& pattern = patterns[p];
+    for (uint32_t k = 0; k <= 3; ++k)
+    {
+      for (const QGramIndex* index : {&dense, &sparse})
+      {
+        if (pattern.size() + 1 < index->getQ() * (k + 1) + 1) continue;
+        for (bool mismatches_only : {false, true})
+        {
+          std::vector<std::pair<uint32_t, uint32_t>> found;
+          for (const auto& match : index->findApproximate(pattern, k, mismatches_only))
+          {
+            found.emplace_back(match.end, match.errors);
+            const string occurrence = text.substr(match.begin, match.end - match.begin);
+            if (!mismatches_only) begin_ok &= editDistance(pattern, occurrence) == match.errors;
+          }
+          const bool eq = found == naiveApproximate(text, starts, pattern, k, mismatches_only);
+          (mismatches_only ? hamming_ok : edit_ok) &= eq;
+          if (!eq) std::cout << "pattern " << p << ", k=" << k << ", q=" << int(index->getQ()) << ", mismatches_only="
+                             << mismatches_only << ": approximate matches differ\n";
+        }
+      }
+    }
+  }
+  if (edit_ok) ++cases;
+  if (hamming_ok) ++cases;
+  if (begin_ok) ++cases;
+
+  // case-insensitive like find(): a lowercase pattern has the matches of the uppercase one
+  bool case_ok = true;
+  for (int p = 0; p < 10; ++p)
+  {
+    string pattern = text.substr(rand() % (text.size() - 60), 60);
+    pattern[rand() % 60] = "ACGT"[rand() % 4];
+    string lower = pattern;
+    for (char& c : lower) c = char(tolower(c));
+    for (bool mismatches_only : {false, true})
+    {
+      std::vector<std::pair<uint32_t, uint32_t>> upper_found, lower_found;
+      for (const auto& match : dense.findApproximate(pattern, 2, mismatches_only)) upper_found.emplace_back(match.end, match.errors);
+      for (const auto& match : dense.findApproximate(lower, 2, mismatches_only)) lower_found.emplace_back(match.end, match.errors);
+      case_ok &= !upper_found.empty() && upper_found == lower_found;
+    }
+  }
+  if (case_ok) ++cases;
+
+  bool thrown = false;
+  try { dense.findApproximate("ACGTACGTAC", 2); } catch (const std::invalid_argument&) { thrown = true; }
+  if (thrown) ++cases;
+
+  return make_pair(cases == 5 ? 2 : 0, 2);
+}
+
+TRT test_packed_text()
+{
+  int cases = 0;
+  srand(46);
+  // every base and every q-gram hash, at all offsets within a word and for lengths around word boundaries
+  bool bases_ok = true, hash_ok = true;
+  for (const size_t n : {0, 1, 31, 32, 33, 64, 65, 1000})
+  {
+    string text(n, 'A');
+    for (auto& c : text) c = "ACGT"[rand() % 4];
+    const PackedText packed(text);
+    bases_ok &= packed.size() == n && packed.isExact();
+    for (size_t i = 0; i < n; ++i) bases_ok &= packed[i] == ordValue(text[i]);
+    for (uint8_t q = 1; q <= 32; ++q)
+    {
+      const RollingHash rolling(q);
+      for (size_t i = 0; i + q <= n; ++i) hash_ok &= packed.hash(i, q) == rolling.hash(text.data() + i);
+    }
+  }
+  if (bases_ok) ++cases;
+  if (hash_ok) ++cases;
+
+  // comparison 32 bases at a time, also for patterns longer than a word
+  string text(5000, 'A');
+  for (auto& c : text) c = "ACGT"[rand() % 4];
+  const PackedText packed(text);
+  bool match_ok = true;
+  for (int i = 0; i < 200; ++i)
+  {
+    const size_t len = 1 + rand() % 150;
+    const size_t pos = rand() % (text.size() - len + 1);
+    string pattern = text.substr(pos, len);
+    match_ok &= packed.matches(pos, PackedText(pattern));
+    match_ok &= !packed.matches(text.size() - len + 1, PackedText(pattern)); // beyond the end
+    const size_t at = rand() % len;
+    pattern[at] = (pattern[at] == 'A') ? 'C' : 'A';
+    match_ok &= !packed.matches(pos, PackedText(pattern));
+  }
+  if (match_ok) ++cases;
+
+  // N and U pack like ordValue(), but are not exact; lower case is exact (case-insensitive, like the hashes)
+  if (!PackedText("ACGTN").isExact() && !PackedText("ACGU").isExact() && PackedText(string(40, 'a')).isExact()
+      && PackedText("acgt")[1] == 1) ++cases;
+
+  // find() must not report an N as a match of A (text and pattern), nor differ for long patterns
+  string mixed = text;
+  for (int i = 0; i < 50; ++i) mixed[rand() % mixed.size()] = 'N';
+  const QGramIndex exact(text, 8);
+  const QGramIndex inexact(mixed, 8);
+  bool find_ok = true;
+  for (int i = 0; i < 100; ++i)
+  {
+    const size_t len = 8 + rand() % 100;
+    const size_t pos = rand() % (text.size() - len + 1);
+    string pattern = text.substr(pos, len); // pure ACGT, also where the other text has an N
+    if (i % 10 == 0) pattern[len / 2] = 'N';
+    for (const string* t : {&text, &mixed})
+    {
+      std::vector<uint32_t> expected;
+      for (size_t j = 0; j + len <= t->size(); ++j)
+        if (sameBases(t->data() + j, pattern.data(), len)) expected.push_back(j);
+      find_ok &= (t == &text ? exact : inexact).find(pattern) == expected;
+    }
+  }
+  if (find_ok) ++cases;
+
+  return make_pair(cases == 5 ? 2 : 0, 2);
+}
+
+TRT test_build_file()
+{
+  int cases = 0;
+  srand(46);
+  // multi-line records, an empty record, CRLF line ends
+  std::ostringstream fasta;
+  for (int r = 0; r < 20; ++r)
+  {
+    fasta << ">rec" << r << " description\r\n";
+    for (int line = (r == 7) ? 0 : rand() % 30; line > 0; --line)
+    {
+      for (int i = 0; i < 60; ++i) fasta << "ACGT"[rand() % 4];
+      fasta << "\n";
+    }
+  }
+  std::istringstream in(fasta.str());
+  const FastaRecords recs = readFasta(in);
+  const string file = "qg_test_stream.idx";
+
+  QGramOptions sparse;
+  sparse.sparse = true;
+  QGramOptions canonical;
+  canonical.canonical = true;
+  QGramOptions minimizer;
+  minimizer.window = 4;
+  bool eq = true;
+  for (const auto& [q, options] : {std::make_pair(uint8_t(6), QGramOptions()), std::make_pair(uint8_t(22), sparse),
+                                   std::make_pair(uint8_t(7), canonical), std::make_pair(uint8_t(8), minimizer)})
+  {
+    std::istringstream stream(fasta.str());
+    std::vector<string> names;
+    const QGramIndex streamed = QGramIndex::buildFile(stream, file, q, options, &names);
+    const QGramIndex built(recs.text, recs.starts, q, options);
+    eq &= names == recs.names && streamed.getTextView() == recs.text && streamed.getRecordCount() == recs.starts.size()
+          && streamed.isSparse() == built.isSparse() && streamed.isCanonical() == built.isCanonical()
+          && streamed.distinctQGrams() == built.distinctQGrams();
+    for (size_t i = 0; i + q <= recs.text.size(); i += 101)
+    {
+      const uint64_t h = built.hash64(recs.text.substr(i, q));
+      eq &= streamed.getHits64(h) == built.getHits64(h);
+      eq &= streamed.resolve(i) == built.resolve(i);
+    }
+    if (!eq) { std::cout << "q=" << int(q) << ": streamed index differs\n"; break; }
+  }
+  if (eq) ++cases;
+
+  // plain text: a single record
+  std::istringstream plain("ACGTTGCA\nGGGACGT\n");
+  std::vector<string> names;
+  const QGramIndex streamed = QGramIndex::buildFile(plain, file, 3, QGramOptions(), &names);
+  if (names.size() == 1 && streamed.getTextView() == "ACGTTGCAGGGACGT" && streamed.find("ACGT") == std::vector<uint32_t>({0, 11})) ++cases;
+
+  std::istringstream empty("");
+  if (QGramIndex::buildFile(empty, file, 4).getTextView().empty()) ++cases;
+
+  try { std::istringstream again(fasta.str()); QGramIndex::buildFile(again, file, 14); }
+  catch (std::invalid_argument&) { ++cases; }
+  std::remove(file.c_str());
+
+  return make_pair(cases == 4 ? 2 : 0, 2);
+}
+
+TRT test_spaced_seeds()
+{
+  int cases = 0;
+  srand(47);
+  // the key is the hash of the characters at the '1's
+  bool extract_ok = true;
+  for (int t = 0; t < 200; ++t)
+  {
+    string mask(2 + rand() % 31, '1');
+    for (size_t i = 1; i + 1 < mask.size(); ++i) mask[i] = "01"[rand() % 2];
+    const SpacedSeed seed(mask);
+    string window(mask.size(), 'A');
+    for (auto& c : window) c = "ACGT"[rand() % 4];
+    string selected;
+    for (size_t i = 0; i < mask.size(); ++i)
+      if (mask[i] == '1') selected += window[i];
+    extract_ok &= seed.span() == mask.size() && seed.weight() == selected.size()
+                  && seed.hash(window.data()) == RollingHash(selected.size()).hash(selected.data());
+  }
+  if (extract_ok) ++cases;
+
+  string text(30000, 'A');
+  for (auto& c : text) c = "ACGT"[rand() % 4];
+  const std::vector<uint32_t> starts = {0, 10000, 10005, 21000};
+  QGramOptions dense_options, sparse_options;
+  dense_options.seed_mask = "1101101";
+  sparse_options.seed_mask = "111010010100110111";
+  sparse_options.sparse = true;
+  const QGramIndex dense(text, starts, 5, dense_options);
+  const QGramIndex sparse(text, starts, 11, sparse_options);
+
+  // every bucket holds exactly the windows (within one record) that agree at the '1's, in decreasing order
+  bool hits_ok = true;
+  for (const QGramIndex* index : {&dense, &sparse})
+  {
+    const string& mask = index->getSeed().getMask();
+    const auto agree = [&](size_t a, size_t b) {
+      for (size_t i = 0; i < mask.size(); ++i)
+        if (mask[i] == '1' && text[a + i] != text[b + i]) return false;
+      return true;
+    };
+    const auto inRecord = [&](size_t pos) {
+      const size_t r = std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin() - 1;
+      const size_t end = (r + 1 < starts.size()) ? starts[r + 1] : text.size();
+      return pos + mask.size() <= end;
+    };
+    for (size_t i = 0; i + mask.size() <= text.size(); i += 97)
+    {
+      if (!inRecord(i)) continue;
+      std::vector<uint32_t> expected;
+      for (size_t j = text.size() - mask.size() + 1; j-- > 0;)
+        if (inRecord(j) && agree(i, j)) expected.push_back(j);
+      hits_ok &= index->getHits64(index->hash64(text.substr(i, mask.size()))) == expected;
+    }
+  }
+  if (hits_ok) ++cases;
+
+  // find() and findApproximate() against naive searches
+  bool find_ok = true;
+  for (int p = 0; p < 40; ++p)
+  {
+    const size_t len = 18 + rand() % 30;
+    string pattern = text.substr(rand() % (text.size() - len), len);
+    std::vector<uint32_t> expected;
+    for (size_t r = 0; r < starts.size(); ++r)
+    {
+      const size_t end = (r + 1 < starts.size()) ? starts[r + 1] : text.size();
+      for (size_t i = starts[r]; i + len <= end; ++i)
+        if (text.compare(i, len, pattern) == 0) expected.push_back(i);
+    }
+    find_ok &= dense.find(pattern) == expected && sparse.find(pattern) == expected;
+    for (int e = 0; e < 2; ++e) pattern[rand() % len] = "ACGT"[rand() % 4];
+    for (const bool mismatches_only : {true, false})
+    {
+      // q-gram lemma for span 7, weight 5: m >= 7 + k*5 (mismatches), m >= 7 + k*7 (edits)
+      const uint32_t k = 2;
+      if (len < 7 + k * (mismatches_only ? 5 : 7)) continue;
+      std::vector<std::pair<uint32_t, uint32_t>> found;
+      for (const auto& match : dense.findApproximate(pattern, k, mismatches_only)) found.emplace_back(match.end, match.errors);
+      find_ok &= found == naiveApproximate(text, starts, pattern, k, mismatches_only);
+    }
+  }
+  if (find_ok) ++cases;
+
+  // the mask survives save() / load() and merging
+  {
+    const string file = "qg_test_spaced.idx";
+    dense.save(file);
+    const QGramIndex loaded = QGramIndex::load(file);
+    IncrementalQGramIndex grown(QGramIndex::load(file));
+    grown.add({text.substr(0, 5000)});
+    const string pattern = text.substr(1234, 20);
+    std::vector<uint32_t> expected = dense.find(pattern);
+    expected.push_back(text.size() + 1234);
+    if (loaded.getSeed().getMask() == "1101101" && loaded.find(pattern) == dense.find(pattern) && grown.find(pattern) == expected)
+      ++cases;
+    std::remove(file.c_str());
+  }
+
+  // invalid masks: wrong weight, not starting with '1', with canonical keys; pattern shorter than the span
+  int thrown = 0;
+  QGramOptions bad;
+  bad.seed_mask = "1101101";
+  try { QGramIndex(text, 4, bad); } catch (const std::invalid_argument&) { ++thrown; }
+  bad.seed_mask = "0110111";
+  try { QGramIndex(text, 5, bad); } catch (const std::invalid_argument&) { ++thrown; }
+  bad.seed_mask = "1101101";
+  bad.canonical = true;
+  try { QGramIndex(text, 5, bad); } catch (const std::invalid_argument&) { ++thrown; }
+  try { dense.find("ACGTAC"); } catch (const std::invalid_argument&) { ++thrown; }
+  if (thrown == 4) ++cases;
+
+  return make_pair(cases == 5 ? 2 : 0, 2);
+}
+
+TRT test_seed_extract()
+{
+  // known answers for fixed masks, then pext (if the CPU has it) against the portable compress on random spans
+  const std::vector<std::pair<string, std::vector<uint64_t>>> known = {
+    {"1101101", {0xfb, 0x304, 0x3ff}},
+    {"111010010100110111", {0x1eaf6f, 0x215090, 0x3fffff}},
+    {"10000000000000000000000000000001", {0x3, 0xc, 0xf}},
+    {"11111111111111111111111111111111", {0x0123456789abcdef, 0xfedcba9876543210, 0xffffffffffffffff}},
+    {"1011", {0x3f, 0x0, 0x3f}}};
+  const uint64_t spans[] = {0x0123456789abcdef, 0xfedcba9876543210, 0xffffffffffffffff};
+  bool known_ok = true, paths_ok = true;
+  bool has_pext = false;
+#ifdef QG_HAVE_PEXT
+  has_pext = __builtin_cpu_supports("bmi2");
+#endif
+  srand(47);
+  for (const auto& [mask, keys] : known)
+  {
+    const SpacedSeed seed(mask);
+    const uint64_t span_bits = (mask.size() == 32) ? ~uint64_t(0) : (uint64_t(1) << 2 * mask.size()) - 1;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+      known_ok &= seed.extractPortable(spans[i] & span_bits) == keys[i] && seed.extract(spans[i] & span_bits) == keys[i];
+#ifdef QG_HAVE_PEXT
+      if (has_pext) known_ok &= seed.extractPext(spans[i] & span_bits) == keys[i];
+#endif
+    }
+#ifdef QG_HAVE_PEXT
+    for (int t = 0; has_pext && t < 1000; ++t)
+    {
+      const uint64_t h = ((uint64_t(rand()) << 42) ^ (uint64_t(rand()) << 21) ^ uint64_t(rand())) & span_bits;
+      paths_ok &= seed.extractPext(h) == seed.extractPortable(h);
+    }
+#endif
+  }
+  if (!has_pext) std::cout << "  (no BMI2: pext path not tested)\n";
+  return make_pair(known_ok && paths_ok ? 2 : 0, 2);
+}
+
+TRT test_serve()
+{
+  int cases = 0;
+  srand(48);
+  std::string text;
+  for (int i = 0; i < 20000; ++i) text += "ACGT"[rand() % 4];
+  const QGramIndex index(text, {0, 12000}, 8);
+  const std::vector<string> names = {"first", "second"};
+  std::vector<string> queries;
+  for (int i = 0; i < 50; ++i) queries.push_back(text.substr(rand() % 19000, 5 + rand() % 30));
+  std::ostringstream input, expected;
+  for (size_t i = 0; i < queries.size(); ++i) input << queries[i] << ((i % 7 == 0) ? "\r\n\n" : "\n"); // CRLF, blank lines
+  input << "\n  ACGTACGTTT  \n";
+  ServeOptions options;
+  options.print_hits = true;
+  options.batch_size = 8;
+  for (const string& query : queries) expected << answerQuery(index, query, names, options);
+  expected << answerQuery(index, "ACGTACGTTT", names, options);
+
+  // stdin-like stream: all input is buffered, i.e. full batches
+  std::istringstream in(input.str());
+  std::ostringstream out;
+  const ServeStats stats = serveQueries(index, in, out, names, options);
+  if (out.str() == expected.str() && stats.queries == 51 && stats.batches == 7 && stats.latencies.size() == 51
+      && stats.percentile(50) <= stats.percentile(99) && stats.percentile(99) <= stats.percentile(100)) ++cases;
+
+  // a query without an answer does not end the stream
+  options.max_errors = 2;
+  const string similar = text.substr(100, 40);
+  std::istringstream approximate("ACGT\n" + similar + "\n");
+  std::ostringstream answers;
+  serveQueries(index, approximate, answers, names, options);
+  if (answers.str().rfind("ACGT: error: ", 0) == 0
+      && answers.str().substr(answers.str().find('\n') + 1) == answerQuery(index, similar, names, options)) ++cases;
+  options.max_errors = -1;
+
+  // Unix socket: one connection
+  const string path = "qg_test_serve.sock";
+  std::ostringstream log;
+  std::thread server([&]() { serveSocket(index, path, names, options, log, 1); });
+  string received;
+  for (int attempt = 0; attempt < 100 && received.empty(); ++attempt)
+  {
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+    {
+      const string sent = input.str();
+      if (::write(fd, sent.data(), sent.size()) == ssize_t(sent.size())) ::shutdown(fd, SHUT_WR);
+      char buffer[4096];
+      for (ssize_t n; (n = ::read(fd, buffer, sizeof(buffer))) > 0;) received.append(buffer, n);
+    }
+    else std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ::close(fd);
+  }
+  server.join();
+  if (received == expected.str() && log.str().rfind("connection 1: 51 queries", 0) == 0) ++cases;
+
+  return make_pair(cases == 3 ? 2 : 0, 2);
+}
+
+/// @p n random bases (rand())
+static string randomDNA(const size_t n)
+{
+  string s(n, 'A');
+  for (auto& c : s) c = "ACGT"[rand() % 4];
+  return s;
+}
+
+TRT test_de_bruijn()
+{
+  int cases = 0;
+  srand(51);
+  DeBruijnOptions forward;
+  forward.canonical = false;
+
+  // a random genome is a single unitig (canonical: either strand), without links; an N splits it, lowercase
+  // characters are bases like uppercase ones
+  const std::string genome = randomDNA(3000);
+  {
+    const DeBruijnGraph both(genome, {}, 21), one(genome, {}, 21, forward);
+    std::string with_n = genome, lower = genome;
+    with_n[1500] = 'N';
+    for (size_t i = 1000; i < 2000; ++i) lower[i] = char(tolower(lower[i]));
+    const DeBruijnGraph split(with_n, {}, 21, forward), lowercase(lower, {}, 21, forward);
+    if (both.getUnitigs().size() == 1 && both.kmerCount() == 3000 - 20 && both.links().empty()
+        && (both.getUnitigs()[0].sequence == genome || both.getUnitigs()[0].sequence == reverseComplement(genome))
+        && one.getUnitigs().size() == 1 && one.getUnitigs()[0].sequence == genome && one.getUnitigs()[0].kmer_count == 3000 - 20
+        && split.getUnitigs().size() == 2 && split.kmerCount() == 3000 - 2 * 21 + 1
+        && lowercase.getUnitigs().size() == 1 && lowercase.getUnitigs()[0].sequence == genome) ++cases;
+  }
+
+  // X R Y R Z: the repeat R becomes a unitig of its own, linked from X and Y and to Y and Z
+  {
+    std::string X = randomDNA(300), R = randomDNA(50), Y = randomDNA(300), Z = randomDNA(300);
+    // the repeat must not extend: different bases before and after its copies
+    if (Y.back() == X.back()) Y.back() = (X.back() == 'A') ? 'C' : 'A';
+    if (Z[0] == Y[0]) Z[0] = (Y[0] == 'A') ? 'C' : 'A';
+    const std::string text = X + R + Y + R + Z;
+    bool ok = true;
+    for (const bool canonical : {false, true})
+    {
+      DeBruijnOptions options;
+      options.canonical = canonical;
+      const DeBruijnGraph graph(text, {}, 15, options);
+      const auto& unitigs = graph.getUnitigs();
+      // every k-mer of the text is in exactly one unitig, and the unitigs cover nothing else
+      std::map<string, int> seen;
+      for (const Unitig& unitig : unitigs)
+        for (size_t i = 0; i + 15 <= unitig.sequence.size(); ++i)
+        {
+          const string kmer = unitig.sequence.substr(i, 15);
+          seen[canonical ? std::min(kmer, reverseComplement(kmer)) : kmer]++;
+        }
+      std::set<string> expected;
+      for (size_t i = 0; i + 15 <= text.size(); ++i)
+      {
+        const string kmer = text.substr(i, 15);
+        expected.insert(canonical ? std::min(kmer, reverseComplement(kmer)) : kmer);
+      }
+      bool partition = seen.size() == expected.size();
+      for (const auto& [kmer, times] : seen) partition &= times == 1 && expected.count(kmer);
+      // the unitig spelling R (or its reverse complement) has count 2 per k-mer
+      size_t repeat = unitigs.size();
+      for (size_t u = 0; u < unitigs.size(); ++u)
+        if (unitigs[u].sequence == R || unitigs[u].sequence == reverseComplement(R)) repeat = u;
+      ok &= partition && unitigs.size() == 4 && graph.links().size() == 4 && repeat < unitigs.size()
+            && unitigs[repeat].kmer_count == 2 * (50 - 15 + 1)
+            && graph.count(RollingHash(15).hash(R.data())) == 2;
+      size_t touching = 0;
+      for (const auto& [from, from_reversed, to, to_reversed] : graph.links())
+        touching += (from == repeat) + (to == repeat);
+      ok &= touching == 4;
+    }
+    if (ok) ++cases;
+  }
+
+  // a circular genome is a cycle: one unitig, linked to itself; k-mers seen once are dropped with min_count 2
+  {
+    const std::string circle = randomDNA(200);
+    const DeBruijnGraph cycle(circle + circle.substr(0, 14), {}, 15, forward);
+    const auto links = cycle.links();
+    DeBruijnOptions filtered = forward;
+    filtered.min_count = 2;
+    std::string reads = circle + circle.substr(0, 14);
+    std::vector<uint32_t> starts = {0, uint32_t(reads.size())};
+    std::string erroneous = circle;
+    erroneous[100] = (erroneous[100] == 'A') ? 'C' : 'A';
+    reads += erroneous + erroneous.substr(0, 14);
+    const DeBruijnGraph clean(reads, starts, 15, filtered);
+    if (cycle.getUnitigs().size() == 1 && cycle.getUnitigs()[0].sequence.size() == 200 + 14 && links.size() == 1
+        && links[0] == std::make_tuple(0u, false, 0u, false)
+        && clean.kmerCount() == 200 - 15 && clean.getUnitigs().size() == 1) ++cases;
+  }
+
+  // GFA; the graph of an index equals the one from the text; invalid k and minimizer indexes throw
+  {
+    const DeBruijnGraph graph(genome.substr(0, 40), {}, 31, forward);
+    std::ostringstream gfa;
+    graph.writeGFA(gfa);
+    QGramOptions index_options;
+    index_options.sparse = true;
+    index_options.canonical = true;
+    const QGramIndex index(genome, 21, index_options);
+    const DeBruijnGraph from_index(index), from_text(genome, {}, 21);
+    int thrown = 0;
+    try { DeBruijnGraph(genome, {}, 1); } catch (const std::invalid_argument&) { ++thrown; }
+    try { DeBruijnGraph(genome, {}, 33); } catch (const std::invalid_argument&) { ++thrown; }
+    QGramOptions minimizers;
+    minimizers.window = 5;
+    try { DeBruijnGraph(QGramIndex(genome, 8, minimizers)); } catch (const std::invalid_argument&) { ++thrown; }
+    if (gfa.str() == "H\tVN:Z:1.0\nS\t0\t" + genome.substr(0, 40) + "\tLN:i:40\tKC:i:10\n"
+        && from_index.getUnitigs().size() == 1 && from_index.getUnitigs()[0].sequence == from_text.getUnitigs()[0].sequence
+        && thrown == 3) ++cases;
+  }
+
+  // reads as dbg_main takes them (readSequences): every plain text line or FASTQ record is a read, no k-mer spans
+  // two reads, and FASTQ qualities are not sequence
+  {
+    std::istringstream plain("ACGTTGCA\nGGGCCCAT\n");
+    std::istringstream fastq("@r1 first\nACGTTGCA\n+\nGGGGGGGG\n@r2\nGGGCCCAT\n+r2\nIIIIIIII\n");
+    const FastaRecords lines = readSequences(plain), records = readSequences(fastq);
+    const DeBruijnGraph from_lines(lines.text, lines.starts, 5, forward), from_fastq(records.text, records.starts, 5, forward);
+    bool ok = lines.names == std::vector<string>{"1", "2"} && records.names == std::vector<string>{"r1", "r2"};
+    for (const DeBruijnGraph* graph : {&from_lines, &from_fastq})
+      ok &= graph->kmerCount() == 8 && graph->getUnitigs().size() == 2 && graph->links().empty()
+            && graph->getUnitigs()[0].sequence == "ACGTTGCA" && graph->getUnitigs()[1].sequence == "GGGCCCAT";
+    if (ok) ++cases;
+  }
+
+  // parallel compaction: the same graph with 4 threads, for reads with errors (many branches and short unitigs)
+  {
+    std::string reads;
+    std::vector<uint32_t> starts;
+    for (int r = 0; r < 400; ++r)
+    {
+      starts.push_back(uint32_t(reads.size()));
+      string read = genome.substr(rand() % (genome.size() - 80), 80);
+      if (rand() % 3 == 0) read[rand() % read.size()] = "ACGT"[rand() % 4];
+      reads += (rand() % 2) ? reverseComplement(read) : read;
+    }
+    omp_set_num_threads(4);
+    const DeBruijnGraph parallel(reads, starts, 15);
+    omp_set_num_threads(1);
+    const DeBruijnGraph sequential(reads, starts, 15);
+    bool same = parallel.kmerCount() == sequential.kmerCount() && parallel.links() == sequential.links()
+                && parallel.getUnitigs().size() == sequential.getUnitigs().size() && sequential.getUnitigs().size() > 10;
+    for (size_t u = 0; same && u < sequential.getUnitigs().size(); ++u)
+      same &= parallel.getUnitigs()[u].sequence == sequential.getUnitigs()[u].sequence
+              && parallel.getUnitigs()[u].kmer_count == sequential.getUnitigs()[u].kmer_count;
+    if (same) ++cases;
+  }
+
+  return make_pair(cases == 6 ? 2 : 0, 2);
+}
+
 int main(int argc, const char * argv[])
 {
   if (argc != 2)
@@ -265,7 +1677,7 @@ int main(int argc, const char * argv[])
 
   int points = 0;
   
-  // even if OMP is supported, do all the tests without parallelization (since hits might be in mangled order due to partial sums)
+  // even if OMP is supported, do all the tests without parallelization (test_parallel_build compares against it)
   omp_set_num_threads(1);
 
   report(points, &test_exceptions, "test_exceptions");  // 2
@@ -273,6 +1685,24 @@ int main(int argc, const char * argv[])
   report(points, &test_hashNext, "test_hashNext");      // 2
   report(points, &test_q_and_text, "test_q_and_text");  // 1
   report(points, &test_getHits, "test_getHits");        // 4
+  report(points, &test_parallel_build, "test_parallel_build"); // 2
+  report(points, &test_sparse, "test_sparse");          // 2
+  report(points, &test_save_load, "test_save_load");    // 2
+  report(points, &test_records, "test_records");        // 2
+  report(points, &test_minimizers, "test_minimizers");  // 2
+  report(points, &test_find, "test_find");              // 2
+  report(points, &test_hits_view, "test_hits_view");    // 2
+  report(points, &test_canonical, "test_canonical");    // 2
+  report(points, &test_kmer_counter, "test_kmer_counter"); // 2
+  report(points, &test_compressed, "test_compressed");  // 2
+  report(points, &test_incremental, "test_incremental"); // 2
+  report(points, &test_approximate, "test_approximate"); // 2
+  report(points, &test_packed_text, "test_packed_text"); // 2
+  report(points, &test_build_file, "test_build_file");  // 2
+  report(points, &test_spaced_seeds, "test_spaced_seeds"); // 2
+  report(points, &test_seed_extract, "test_seed_extract"); // 2
+  report(points, &test_serve, "test_serve");            // 2
+  report(points, &test_de_bruijn, "test_de_bruijn");    // 2
 
   // bonus points
   report(points, [&file]() { return test_BONUS(file);}, "test_BONUS OpenMP");
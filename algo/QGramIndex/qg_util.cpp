@@ -1,3 +1,4 @@
+#include "qg_util.hpp"
 
 // table to convert DNA/RNA bases in ASCII to values from 0 to 3
 // a|A|* -> 0, c|C -> 1, g|G -> 2, t|T|u|U -> 3
@@ -46,3 +47,24 @@ unsigned char dna(const unsigned ordVal)
 {
     return Translate_Table_DNA_2_ASCII[ordVal];
 }
+
+std::string reverseComplement(const std::string& seq)
+{
+    std::string rc(seq.rbegin(), seq.rend());
+    for (auto& c : rc) c = dna(3 - ordValue(c));
+    return rc;
+}
+
+bool sameBase(const unsigned char x, const unsigned char y)
+{
+    const unsigned char upper = x & 0xDF; // a|c|g|t -> A|C|G|T
+    return upper == (y & 0xDF) && (upper == 'A' || upper == 'C' || upper == 'G' || upper == 'T');
+}
+
+bool sameBases(const char* a, const char* b, const size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (!sameBase(a[i], b[i])) return false;
+    }
+    return true;
+}
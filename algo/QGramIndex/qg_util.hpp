@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <string>
+
 // call this function to convert a char to an ordinal value
 // i.e.: 
 //       a|A|* -> 0, c|C -> 1, g|G -> 2, t|T|u|U -> 3
@@ -7,3 +10,12 @@ unsigned ordValue(const unsigned char x);
 
 // call this function to convert an ordinal value (0-3) to a character
 unsigned char dna(const unsigned ordVal);
+
+// reverse complement of a DNA sequence (characters other than ACGTU are treated like 'A', see ordValue())
+std::string reverseComplement(const std::string& seq);
+
+// whether x and y are the same base, ACGT in either case; other characters match nothing, not even themselves
+bool sameBase(const unsigned char x, const unsigned char y);
+
+// whether the n characters at a and b are the same bases (see sameBase())
+bool sameBases(const char* a, const char* b, const size_t n);
@@ -1,79 +1,81 @@
 #include "Alignment.hpp"
 
 
-Alignment::Alignment(const std::string& seq_v, const std::string& seq_h) {
-    this->seqv = seq_v;
-    this->seqh = seq_h;
+Alignment::Alignment(const std::string& seq_v, const std::string& seq_h) :
+    ownV(seq_v), ownH(seq_h), seqv(ownV), seqh(ownH),
+    ownWorkspace(std::make_unique<AlignmentWorkspace>()), ws(ownWorkspace.get()) {
+}
+
+Alignment::Alignment(std::string_view seq_v, std::string_view seq_h, AlignmentWorkspace& workspace) :
+    seqv(seq_v), seqh(seq_h), ws(&workspace) {
+}
+
+Alignment::~Alignment() = default;
+
+void Alignment::prepareWorkspace() {
+    ws->owner = this;
+    width = seqh.size()+1;
+    height = seqv.size()+1;
+    const size_t cells = static_cast<size_t>(width) * height;
+    // grow only: the old contents are overwritten cell by cell
+    if (ws->f.size() < cells) {
+        ws->f.resize(cells);
+        ws->t.resize(cells);
+    }
 }
 
 void Alignment::compute(const int match, const int mismatch, const int gap, const bool local_align) {
     computeCalled = true;
-    if (local_align) smithWaterman = true;
+    engine = Engine::DP;
+    smithWaterman = local_align;
 
-    f.clear();
-    t.clear();
+    prepareWorkspace();
+    int* f = ws->f.data();
+    Traceback* t = ws->t.data();
 
-    uint32_t width = seqh.size()+1;
-    uint32_t height = seqv.size()+1;
     int maxScore = 0;
     int matchScore = 0;
 
-
-    f.resize(width, std::vector<int>(height));
-    t.resize(width, std::vector<Traceback>(height));
-
     // Initialization
 
-    f[0][0] = 0;
-    t[0][0] = Traceback::NONE;
+    f[cell(0, 0)] = 0;
+    t[cell(0, 0)] = Traceback::NONE;
 
     for (uint32_t i = 0; i < width; i++) {
         if (smithWaterman) {
-            f[i][0] = 0;
-            t[i][0] = Traceback::NONE;
+            f[cell(i, 0)] = 0;
+            t[cell(i, 0)] = Traceback::NONE;
         }
         else {
-            f[i][0] = static_cast<int>(i) * gap;
-            t[i][0] = Traceback::HORIZONTAL;
+            f[cell(i, 0)] = static_cast<int>(i) * gap;
+            t[cell(i, 0)] = Traceback::HORIZONTAL;
         }
     }
     for (uint32_t j = 0; j < height; j++) {
         if (smithWaterman) {
-            f[0][j] = 0;
-            t[0][j] = Traceback::NONE;
+            f[cell(0, j)] = 0;
+            t[cell(0, j)] = Traceback::NONE;
         }
         else {
-            f[0][j] = static_cast<int>(j) * gap;
-            t[0][j] = Traceback::VERTICAL;
+            f[cell(0, j)] = static_cast<int>(j) * gap;
+            t[cell(0, j)] = Traceback::VERTICAL;
         }
     }
 
-    // Recurrence
+    // Recurrence (row i-1 and row i of the flat matrix are 'height' cells apart)
 
     if (smithWaterman) {
         int globalMaxScore = 0;
 
         for (uint32_t i = 1; i < width; i++) {
+            const int* prev = f + cell(i-1, 0);
+            int* row = f + cell(i, 0);
+            Traceback* trow = t + cell(i, 0);
             for (uint32_t j = 1; j < height; j++) {
                 matchScore = (seqh[i-1] == seqv[j-1]) ? match : mismatch;
 
-                int scoreDiagonal = f[i-1][j-1] + matchScore;
-                int scoreUp = f[i-1][j] + gap;
-                int scoreLeft = f[i][j-1] + gap;
-
-                maxScore = std::max({0, scoreDiagonal, scoreUp, scoreLeft});
-                f[i][j] = maxScore;
-
-                // Update traceback
-                if (maxScore == scoreLeft) {
-                    t[i][j] = Traceback::VERTICAL;
-                } else if (maxScore == scoreUp) {
-                    t[i][j] = Traceback::HORIZONTAL;
-                } else if (maxScore == scoreDiagonal) {
-                    t[i][j] = Traceback::DIAGONAL;
-                } else {
-                    t[i][j] = Traceback::NONE;
-                }
+                maxScore = localCell(prev[j-1] + matchScore, prev[j] + gap, row[j-1] + gap, trow[j]);
+                row[j] = maxScore;
 
                 // Update global max score
                 if (maxScore > globalMaxScore) {
@@ -86,41 +88,209 @@ void Alignment::compute(const int match, const int mismatch, const int gap, cons
         score = globalMaxScore;
     } else {
         for (uint32_t i = 1; i < width; i++) {
+            const int* prev = f + cell(i-1, 0);
+            int* row = f + cell(i, 0);
+            Traceback* trow = t + cell(i, 0);
             for (uint32_t j = 1; j < height; j++) {
                 matchScore = (seqh[i-1] == seqv[j-1]) ? match : mismatch;
 
-                maxScore = f[i][j-1] + gap;
-                t[i][j] = Traceback::VERTICAL;
+                maxScore = row[j-1] + gap;
+                trow[j] = Traceback::VERTICAL;
 
 
-                if (f[i-1][j] + gap > maxScore) {
-                    maxScore = f[i-1][j] + gap;
-                    t[i][j] = Traceback::HORIZONTAL;
+                if (prev[j] + gap > maxScore) {
+                    maxScore = prev[j] + gap;
+                    trow[j] = Traceback::HORIZONTAL;
                 }
-                if (f[i-1][j-1] + matchScore >= maxScore) {
-                    maxScore = f[i-1][j-1] + matchScore;
-                    t[i][j] = Traceback::DIAGONAL;
+                if (prev[j-1] + matchScore >= maxScore) {
+                    maxScore = prev[j-1] + matchScore;
+                    trow[j] = Traceback::DIAGONAL;
                 }
 
-                f[i][j] = maxScore;
+                row[j] = maxScore;
 
             }
         }
-        score = f[width-1][height-1];
+        score = f[cell(width-1, height-1)];
     }
 }
 
-int Alignment::getScore() const {
-    if (!computeCalled) throw(std::runtime_error("Compute hasn't been called!"));
-    return score;
+void Alignment::computeScore(const int match, const int mismatch, const int gap, const bool local_align) {
+    computeCalled = true;
+    engine = Engine::SCORE;
+    smithWaterman = local_align;
+    ws->owner = this;
+    width = seqh.size()+1;
+    height = seqv.size()+1;
+
+    // a single row of the matrix: before cell j is updated, row[j] still holds the previous row's value
+    if (ws->f.size() < height) ws->f.resize(height);
+    int* row = ws->f.data();
+    for (uint32_t j = 0; j < height; j++) row[j] = local_align ? 0 : static_cast<int>(j) * gap;
+
+    int best = 0;
+    for (uint32_t i = 1; i < width; i++) {
+        int diagonal = row[0];
+        row[0] = local_align ? 0 : static_cast<int>(i) * gap;
+        for (uint32_t j = 1; j < height; j++) {
+            const int up = row[j];
+            const int matchScore = (seqh[i-1] == seqv[j-1]) ? match : mismatch;
+            int value = std::max({diagonal + matchScore, up + gap, row[j-1] + gap});
+            if (local_align) {
+                value = std::max(value, 0);
+                best = std::max(best, value);
+            }
+            diagonal = up;
+            row[j] = value;
+        }
+    }
+    score = local_align ? best : row[height-1];
 }
 
-void Alignment::getAlignment(std::string& a1, std::string& gaps, std::string& a2) const {
+Alignment::Wavefront& Alignment::wavefront(const int s) {
+    // grows on demand; old entries keep their buffers for the next call
+    const size_t idx = s;
+    if (idx >= ws->wavefronts.size()) ws->wavefronts.resize(idx+1);
+    return ws->wavefronts[idx];
+}
+
+void Alignment::computeWFA(const int match, const int mismatch, const int gap, const bool score_only) {
+    // Penalties (see Eizenga & Paten): for any global alignment
+    //   2*score = match*(n+m) - (2*(match-mismatch)*#mismatches + (match-2*gap)*#gaps)
+    // so maximizing the score is the same as minimizing the penalty with a free match.
+    int x = 2 * (match - mismatch);
+    int g = match - 2 * gap;
+    if (x <= 0 || g <= 0) throw(std::invalid_argument("WFA requires match > mismatch and match > 2*gap!"));
+    const int divisor = std::gcd(x, g);
+    x /= divisor;
+    g /= divisor;
+
+    computeCalled = true;
+    smithWaterman = false;
+    engine = Engine::WFA;
+    wfaScoreOnly = score_only;
+    ws->owner = this;
+    ws->wfaBegin = ws->wfaEnd = 0;
+
+    const int n = seqh.size();
+    const int m = seqv.size();
+    const int kEnd = n - m;
+    const int none = std::numeric_limits<int>::min() / 2;
+    const int ring = std::max(x, g) + 1;
+
+    auto extend = [&](const int k, int i) {
+        int j = i - k;
+        while (i < n && j < m && seqh[i] == seqv[j]) { ++i; ++j; }
+        return i;
+    };
+    auto slot = [&](const int s) -> Wavefront& { return wavefront(score_only ? s % ring : s); };
+    auto at = [&](const Wavefront& w, const int k) {
+        return (w.null || k < w.lo || k > w.hi) ? none : w.offsets[k - w.lo];
+    };
+
+    // s = 0: follow the main diagonal as far as it matches
+    Wavefront& w0 = slot(0);
+    w0.lo = 0;
+    w0.hi = 0;
+    w0.null = false;
+    w0.offsets.assign(1, extend(0, 0));
+    int s = 0;
+    bool done = (kEnd == 0 && w0.offsets[0] == n);
+
+    while (!done) {
+        ++s;
+        Wavefront& cur = slot(s); // may grow the wavefront list, so fetch it before its sources
+        const Wavefront* wx = (s >= x && !slot(s - x).null) ? &slot(s - x) : nullptr;
+        const Wavefront* wg = (s >= g && !slot(s - g).null) ? &slot(s - g) : nullptr;
+        cur.null = (wx == nullptr && wg == nullptr);
+        if (cur.null) continue;
+
+        int lo = std::numeric_limits<int>::max();
+        int hi = std::numeric_limits<int>::min();
+        if (wx) { lo = std::min(lo, wx->lo); hi = std::max(hi, wx->hi); }
+        if (wg) { lo = std::min(lo, wg->lo - 1); hi = std::max(hi, wg->hi + 1); }
+        cur.lo = std::max(lo, -m);
+        cur.hi = std::min(hi, n);
+        cur.offsets.resize(cur.hi - cur.lo + 1);
+
+        for (int k = cur.lo; k <= cur.hi; k++) {
+            int best = none;
+            if (wx) best = std::max(best, at(*wx, k) + 1);      // mismatch
+            if (wg) {
+                best = std::max(best, at(*wg, k - 1) + 1);      // gap in seqv (consume seqh)
+                best = std::max(best, at(*wg, k + 1));          // gap in seqh (consume seqv)
+            }
+            if (best < 0 || best > n || best - k > m) best = none;
+            else best = extend(k, best);
+            cur.offsets[k - cur.lo] = best;
+        }
+        done = (at(cur, kEnd) == n);
+    }
+
+    score = (match * (n + m) - s * divisor) / 2;
+    if (!score_only) wfaBacktrace(s, x, g);
+}
+
+void Alignment::wfaBacktrace(const int final_penalty, const int x, const int g) {
+    const int n = seqh.size();
+    const int m = seqv.size();
+    const int none = std::numeric_limits<int>::min() / 2;
+    auto at = [&](const int s, const int k) {
+        if (s < 0) return none;
+        const Wavefront& w = ws->wavefronts[s];
+        return (w.null || k < w.lo || k > w.hi) ? none : w.offsets[k - w.lo];
+    };
+
+    // an alignment has at most n+m columns; fill them from the back so no reversal is needed
+    if (ws->wfaOps.size() < static_cast<size_t>(n + m)) ws->wfaOps.resize(n + m);
+    EditOp* out = ws->wfaOps.data() + n + m;
+    auto put = [&out](const int count, const EditOp op) {
+        for (int c = 0; c < count; c++) *--out = op;
+    };
+
+    int s = final_penalty;
+    int k = n - m;
+    int off = n;
+    while (s > 0) {
+        const int fromX = at(s - x, k) + 1;
+        const int fromI = at(s - g, k - 1) + 1;
+        const int fromD = at(s - g, k + 1);
+        const int pre = std::max({fromX, fromI, fromD});
+        put(off - pre, EditOp::MATCH);
+        if (pre == fromX) {
+            put(1, EditOp::MISMATCH);
+            s -= x;
+            off = pre - 1;
+        } else if (pre == fromI) {
+            put(1, EditOp::INSERTION);
+            s -= g;
+            k -= 1;
+            off = pre - 1;
+        } else {
+            put(1, EditOp::DELETION);
+            s -= g;
+            k += 1;
+            off = pre;
+        }
+    }
+    put(off, EditOp::MATCH);
+    ws->wfaBegin = out - ws->wfaOps.data();
+    ws->wfaEnd = n + m;
+}
+
+template <typename Visit>
+std::pair<uint32_t, uint32_t> Alignment::traceback(Visit&& visit) const {
     if (!computeCalled) throw(std::runtime_error("Compute hasn't been called!"));
+    if (ws->owner != this) throw(std::runtime_error("Workspace was reused by another alignment!"));
+
+    if (engine == Engine::TOPK) throw(std::runtime_error("Use the CIGARs of the local hits!"));
+    if (engine == Engine::SCORE) throw(std::runtime_error("No traceback after computeScore()!"));
+    if (engine == Engine::WFA) {
+        if (wfaScoreOnly) throw(std::runtime_error("WFA was computed in score-only mode!"));
+        for (size_t c = ws->wfaEnd; c > ws->wfaBegin; c--) visit(ws->wfaOps[c-1]);
+        return {0, 0};
+    }
 
-    a1 = "";
-    a2 = "";
-    gaps = "";
     uint32_t i = seqh.size();
     uint32_t j = seqv.size();
     if (smithWaterman) {
@@ -128,30 +298,238 @@ void Alignment::getAlignment(std::string& a1, std::string& gaps, std::string& a2
         j = localStartJ;
     }
 
-    while (!(i == 0 && j == 0) && (t[i][j] != Traceback::NONE)) {
-        if (t[i][j] == Traceback::DIAGONAL) {
-            a1 += seqv[j-1];
-            a2 += seqh[i-1];
-            gaps += (seqv[j-1] == seqh[i-1]) ? "|" : " ";
+    const Traceback* t = ws->t.data();
+    while (!(i == 0 && j == 0) && (t[cell(i, j)] != Traceback::NONE)) {
+        if (t[cell(i, j)] == Traceback::DIAGONAL) {
+            visit((seqv[j-1] == seqh[i-1]) ? EditOp::MATCH : EditOp::MISMATCH);
             i--; j--;
         }
-        else if (t[i][j] == Traceback::VERTICAL) {
-            a1 += seqv[j-1];
-            a2 += "-";
-            gaps += " ";
+        else if (t[cell(i, j)] == Traceback::VERTICAL) {
+            visit(EditOp::DELETION);
             j--;
         }
         else  {
-            a1 += "-";
-            a2 += seqh[i-1];
-            gaps += " ";
+            visit(EditOp::INSERTION);
             i--;
         }
     }
+    return {j, i};
+}
 
-    std::reverse(a1.begin(), a1.end());
-    std::reverse(gaps.begin(), gaps.end());
-    std::reverse(a2.begin(), a2.end());
+void Alignment::computeLocalTopK(const int match, const int mismatch, const int gap, const uint32_t k,
+                                 std::vector<LocalHit>& hits) {
+    hits.clear();
+    compute(match, mismatch, gap, true);
+    engine = Engine::TOPK;
 
-    std::cout << a1 << "\n" << gaps << "\n" << a2 << "\n";
-}
\ No newline at end of file
+    int* f = ws->f.data();
+    Traceback* t = ws->t.data();
+    const size_t cells = static_cast<size_t>(width) * height;
+    if (ws->blocked.size() < cells) ws->blocked.resize(cells);
+    std::fill(ws->blocked.begin(), ws->blocked.begin() + cells, 0);
+    uint8_t* blocked = ws->blocked.data();
+
+    // best cell per row; scores only decrease while declumping, so a row is only rescanned when its best cell changed
+    ws->rowMax.assign(width, 0);
+    ws->rowArg.assign(width, 0);
+    auto scanRow = [&](const uint32_t i) {
+        ws->rowMax[i] = 0;
+        ws->rowArg[i] = 0;
+        for (uint32_t j = 1; j < height; j++) {
+            if (f[cell(i, j)] > ws->rowMax[i]) {
+                ws->rowMax[i] = f[cell(i, j)];
+                ws->rowArg[i] = j;
+            }
+        }
+    };
+    for (uint32_t i = 1; i < width; i++) scanRow(i);
+
+    // columns of the last hit's path in each row (a path occupies a contiguous column range per row)
+    std::vector<uint32_t> pathLo(width), pathHi(width);
+
+    while (hits.size() < k) {
+        uint32_t bi = 0;
+        for (uint32_t i = 1; i < width; i++) {
+            if (ws->rowMax[i] > ws->rowMax[bi]) bi = i;
+        }
+        if (bi == 0 || ws->rowMax[bi] <= 0) break;
+        const uint32_t bj = ws->rowArg[bi];
+
+        // traceback: count the runs, then fill the CIGAR from the back (same rules as for a single local alignment)
+        LocalHit hit;
+        hit.score = ws->rowMax[bi];
+        hit.endH = bi;
+        hit.endV = bj;
+        size_t runs = 0;
+        EditOp last{};
+        uint32_t i = bi, j = bj;
+        while (!(i == 0 && j == 0) && t[cell(i, j)] != Traceback::NONE) {
+            EditOp op;
+            if (t[cell(i, j)] == Traceback::DIAGONAL) {
+                op = (seqv[j-1] == seqh[i-1]) ? EditOp::MATCH : EditOp::MISMATCH;
+                i--; j--;
+            } else if (t[cell(i, j)] == Traceback::VERTICAL) {
+                op = EditOp::DELETION;
+                j--;
+            } else {
+                op = EditOp::INSERTION;
+                i--;
+            }
+            if (runs == 0 || op != last) ++runs;
+            last = op;
+        }
+        hit.beginH = i;
+        hit.beginV = j;
+        hit.cigar.resize(runs);
+        CigarRun* out = hit.cigar.data() + runs;
+
+        // second walk: emit the CIGAR and remove the path's cells from the matrix (declumping)
+        const uint32_t i0 = hit.beginH;
+        i = bi; j = bj;
+        for (uint32_t r = i0; r <= bi; r++) {
+            pathLo[r] = height;
+            pathHi[r] = 0;
+        }
+        while (!(i == 0 && j == 0) && t[cell(i, j)] != Traceback::NONE) {
+            const Traceback tb = t[cell(i, j)];
+            blocked[cell(i, j)] = 1;
+            pathLo[i] = std::min(pathLo[i], j);
+            pathHi[i] = std::max(pathHi[i], j);
+            EditOp op;
+            if (tb == Traceback::DIAGONAL) {
+                op = (seqv[j-1] == seqh[i-1]) ? EditOp::MATCH : EditOp::MISMATCH;
+                i--; j--;
+            } else if (tb == Traceback::VERTICAL) {
+                op = EditOp::DELETION;
+                j--;
+            } else {
+                op = EditOp::INSERTION;
+                i--;
+            }
+            if (out == hit.cigar.data() + runs || out->op != op) *--out = CigarRun{0, op};
+            out->length++;
+        }
+        hits.push_back(std::move(hit));
+
+        // recompute only what depends on the removed cells: row by row, starting at the path's columns
+        // (or where the previous row changed) and stopping as soon as nothing changes any more
+        uint32_t lo = height;  // changed columns of the previous row: [lo, hi]
+        uint32_t hi = 0;
+        for (uint32_t r = std::max<uint32_t>(i0, 1); r < width; r++) {
+            const bool onPath = (r <= bi && pathLo[r] <= pathHi[r]);
+            if (!onPath && lo > hi) {
+                if (r > bi) break;
+                continue;
+            }
+            const uint32_t from = std::max<uint32_t>(1, std::min(onPath ? pathLo[r] : height, lo));
+            const uint32_t until = std::max(onPath ? pathHi[r] : 0, (lo <= hi) ? hi + 1 : 0);
+            uint32_t newLo = height;
+            uint32_t newHi = 0;
+            bool leftChanged = false;
+            const int* prev = f + cell(r-1, 0);
+            int* row = f + cell(r, 0);
+            Traceback* trow = t + cell(r, 0);
+            const uint8_t* brow = blocked + cell(r, 0);
+            for (uint32_t c = from; c < height && (c <= until || leftChanged); c++) {
+                int value = 0;
+                if (brow[c]) {
+                    trow[c] = Traceback::NONE;
+                } else {
+                    const int matchScore = (seqh[r-1] == seqv[c-1]) ? match : mismatch;
+                    value = localCell(prev[c-1] + matchScore, prev[c] + gap, row[c-1] + gap, trow[c]);
+                }
+                leftChanged = (value != row[c]);
+                if (leftChanged) {
+                    row[c] = value;
+                    newLo = std::min(newLo, c);
+                    newHi = c;
+                }
+            }
+            if (newLo <= newHi && ws->rowArg[r] >= newLo && ws->rowArg[r] <= newHi) scanRow(r);
+            lo = newLo;
+            hi = newHi;
+        }
+    }
+    score = hits.empty() ? 0 : hits.front().score;
+}
+
+int Alignment::getScore() const {
+    if (!computeCalled) throw(std::runtime_error("Compute hasn't been called!"));
+    return score;
+}
+
+std::pair<uint32_t, uint32_t> Alignment::getAlignmentStart() const {
+    return traceback([](const EditOp) {});
+}
+
+void Alignment::getEditOps(std::vector<EditOp>& ops) const {
+    // the traceback runs backwards: count first, then fill the buffer from its end
+    size_t count = 0;
+    traceback([&count](const EditOp) { ++count; });
+    ops.resize(count);
+    EditOp* out = ops.data() + count;
+    traceback([&out](const EditOp op) { *--out = op; });
+}
+
+void Alignment::getCigar(std::vector<CigarRun>& cigar) const {
+    size_t runs = 0;
+    EditOp last{};
+    traceback([&](const EditOp op) {
+        if (runs == 0 || op != last) ++runs;
+        last = op;
+    });
+    cigar.resize(runs);
+    CigarRun* out = cigar.data() + runs;
+    traceback([&](const EditOp op) {
+        if (out == cigar.data() + runs || out->op != op) *--out = CigarRun{0, op};
+        out->length++;
+    });
+}
+
+void Alignment::getAlignment(std::string& a1, std::string& gaps, std::string& a2) const {
+    std::vector<EditOp> ops;
+    getEditOps(ops);
+    auto [j, i] = getAlignmentStart();
+
+    a1.resize(ops.size());
+    gaps.resize(ops.size());
+    a2.resize(ops.size());
+    for (size_t c = 0; c < ops.size(); c++) {
+        switch (ops[c]) {
+            case EditOp::MATCH:
+            case EditOp::MISMATCH:
+                a1[c] = seqv[j++];
+                a2[c] = seqh[i++];
+                gaps[c] = (ops[c] == EditOp::MATCH) ? '|' : ' ';
+                break;
+            case EditOp::DELETION:
+                a1[c] = seqv[j++];
+                a2[c] = '-';
+                gaps[c] = ' ';
+                break;
+            case EditOp::INSERTION:
+                a1[c] = '-';
+                a2[c] = seqh[i++];
+                gaps[c] = ' ';
+                break;
+        }
+    }
+}
+
+std::string cigarToString(const std::vector<CigarRun>& cigar) {
+    std::string out;
+    for (const CigarRun& run : cigar) {
+        out += std::to_string(run.length);
+        out += static_cast<char>(run.op);
+    }
+    return out;
+}
+
+void formatAlignment(std::ostream& os, const std::string& a1, const std::string& gaps, const std::string& a2,
+                     const size_t width) {
+    const size_t step = (width == 0) ? std::max<size_t>(a1.size(), 1) : width;
+    for (size_t pos = 0; pos < a1.size() || pos == 0; pos += step) {
+        os << a1.substr(pos, step) << "\n" << gaps.substr(pos, step) << "\n" << a2.substr(pos, step) << "\n";
+        if (pos + step < a1.size()) os << "\n";
+    }
+}
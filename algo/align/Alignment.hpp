@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <memory>
 #include <cstdint>
 #include <vector>
 #include <utility>
@@ -8,8 +10,38 @@
 #include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <numeric>
 
 
+class AlignmentWorkspace;
+
+/// One alignment column, using the extended SAM CIGAR letters.
+/// seq_v is treated as the reference and seq_h as the query, i.e.
+/// INSERTION is a gap in seq_v and DELETION a gap in seq_h.
+enum class EditOp : char {
+  MATCH = '=',
+  MISMATCH = 'X',
+  INSERTION = 'I',
+  DELETION = 'D',
+};
+
+/// A run of @p length identical operations (one CIGAR element)
+struct CigarRun {
+  uint32_t length;
+  EditOp op;
+};
+
+/// A local alignment as reported by Alignment::computeLocalTopK()
+struct LocalHit {
+  int score;
+  uint32_t beginV; ///< aligned region in seq_v: [beginV, endV)
+  uint32_t endV;
+  uint32_t beginH; ///< aligned region in seq_h: [beginH, endH)
+  uint32_t endH;
+  std::vector<CigarRun> cigar;
+};
+
 class Alignment
 {
 public:
@@ -20,12 +52,44 @@ public:
   /// Constructor with two sequences
   /// Makes an internal copy of the sequences.
   Alignment(const std::string& seq_v, const std::string& seq_h);
+
+  /// Constructor with two sequences and an external workspace.
+  /// Does NOT copy the sequences, i.e. they must outlive this object.
+  /// All matrices are kept in @p workspace, which can be reused for many pairs without new allocations
+  /// (see AlignmentWorkspace).
+  Alignment(std::string_view seq_v, std::string_view seq_h, AlignmentWorkspace& workspace);
+
+  /// Not copyable (the sequence views may point into the object itself)
+  Alignment(const Alignment&) = delete;
+  Alignment& operator=(const Alignment&) = delete;
+  ~Alignment();
   
   /// Compute the aligment (i.e. score and traceback)
   /// given the three alignment parameters match, mismatch and gap.
   /// If local_align == true, compute the local Smith-Waterman (SW) alignment (extra points), or throw
   /// an exception if your implementation does not support SW.
   void compute(const int match, const int mismatch, const int gap, const bool local_align = false);
+
+  /// Compute only the score of the (global or local) alignment, in linear memory (a single matrix row).
+  /// getAlignment() etc. throw afterwards.
+  void computeScore(const int match, const int mismatch, const int gap, const bool local_align = false);
+
+  /// Compute the global alignment with the wavefront algorithm (WFA).
+  /// Runs in O(n*s) time, where s is the alignment penalty, i.e. near-linear for highly similar sequences.
+  /// Scores are converted into penalties (a match costs nothing), which requires match > mismatch
+  /// and match > 2*gap (true for any positive match and negative gap score). The resulting score equals compute()'s.
+  /// If score_only == true, only the last max(mismatch, gap) penalty wavefronts are kept in memory
+  /// and getAlignment() throws afterwards.
+  /// @throws std::invalid_argument if the scores cannot be expressed as penalties
+  void computeWFA(const int match, const int mismatch, const int gap, const bool score_only = false);
+
+  /// Compute up to @p k best non-overlapping local alignments (Waterman-Eggert), best first, into @p hits.
+  /// After each hit, the cells of its path are removed from the Smith-Waterman matrix and only the
+  /// cells depending on them are recomputed (declumping), so no two hits share an aligned pair.
+  /// Stops early when no alignment with a positive score is left.
+  /// Afterwards, getScore() returns the best hit's score; getAlignment() etc. throw (use the hits' CIGARs).
+  void computeLocalTopK(const int match, const int mismatch, const int gap, const uint32_t k,
+                        std::vector<LocalHit>& hits);
   
   /// Return the score of the alignment;
   /// Throws an exception if compute(...) was not called first
@@ -40,23 +104,112 @@ public:
   /// gaps: " |   ||||||  |||| "
   /// a2:   "-M--YMISSISAHIPPIE"
   /// , where a1 corresponds to seq1, etc.
-  /// Throws an exception if compute(...) was not called first
+  /// Throws an exception if compute(...) was not called first, or computeWFA(...) ran in score-only mode,
+  /// or the shared workspace was used by another Alignment in the meantime
+  /// Nothing is printed; use formatAlignment() for that.
   void getAlignment(std::string& a1, std::string& gaps, std::string& a2) const;
+
+  /// Write the alignment as one EditOp per column (first to last) into @p ops.
+  /// The buffer is resized to fit, i.e. a reused buffer does not allocate once it is large enough.
+  /// Throws like getAlignment()
+  void getEditOps(std::vector<EditOp>& ops) const;
+
+  /// Same as getEditOps(), but run-length encoded (a CIGAR, e.g. 3=1X2I5=)
+  /// Throws like getAlignment()
+  void getCigar(std::vector<CigarRun>& cigar) const;
+
+  /// Return the 0-based start of the alignment in (seq_v, seq_h);
+  /// always (0, 0) for global alignments, the first aligned positions for local ones.
+  /// Throws like getAlignment()
+  std::pair<uint32_t, uint32_t> getAlignmentStart() const;
   
 private:
+  friend class AlignmentWorkspace;
   enum class Traceback : int8_t{
     NONE,
     DIAGONAL,
     HORIZONTAL,
     VERTICAL,
   };
-  std::string seqv;
-  std::string seqh;
-  std::vector<std::vector<int>> f;
-  std::vector<std::vector<Traceback>> t;
+  enum class Engine : int8_t{
+    DP,
+    WFA,
+    TOPK,
+    SCORE,
+  };
+  /// One wavefront: furthest reaching offsets (in seqh) for the diagonals k = i - j in [lo, hi]
+  struct Wavefront {
+    int lo = 0;
+    int hi = -1;
+    bool null = true;
+    std::vector<int> offsets;
+  };
+  /// Smith-Waterman recurrence of one cell: returns its score and sets its traceback
+  static int localCell(const int scoreDiagonal, const int scoreUp, const int scoreLeft, Traceback& tb) {
+    const int maxScore = std::max({0, scoreDiagonal, scoreUp, scoreLeft});
+    if (maxScore == scoreLeft) tb = Traceback::VERTICAL;
+    else if (maxScore == scoreUp) tb = Traceback::HORIZONTAL;
+    else if (maxScore == scoreDiagonal) tb = Traceback::DIAGONAL;
+    else tb = Traceback::NONE;
+    return maxScore;
+  }
+  Wavefront& wavefront(const int s);
+  void wfaBacktrace(const int final_penalty, const int x, const int g);
+  /// Call visit(EditOp) for each column from the last to the first; returns the alignment start (see getAlignmentStart())
+  template <typename Visit>
+  std::pair<uint32_t, uint32_t> traceback(Visit&& visit) const;
+  /// Claim the workspace for this alignment and make room for a width x height matrix
+  void prepareWorkspace();
+  /// Index of cell (i, j) in the flat matrices; i runs over seqh, j over seqv
+  size_t cell(const uint32_t i, const uint32_t j) const { return static_cast<size_t>(i) * height + j; }
+
+  std::string ownV; // only used by the copying constructor
+  std::string ownH;
+  std::string_view seqv;
+  std::string_view seqh;
+  std::unique_ptr<AlignmentWorkspace> ownWorkspace;
+  AlignmentWorkspace* ws;
+  uint32_t width = 0;
+  uint32_t height = 0;
   int score = 0;
   uint32_t localStartI = 0;
   uint32_t localStartJ = 0;
   bool computeCalled = false;
   bool smithWaterman = false;
+  Engine engine = Engine::DP;
+  bool wfaScoreOnly = false;
 };
+
+/// Grow-only buffers for Alignment: DP matrices (stored flat, one allocation each), WFA wavefronts
+/// and the bookkeeping of computeLocalTopK().
+/// Reuse one workspace for many compute() calls and sequence pairs to avoid per-call allocations;
+/// buffers only grow when a larger problem comes along and are never shrunk.
+/// A workspace serves one Alignment at a time: computing another Alignment on it invalidates the
+/// traceback of the previous one (getAlignment() throws). Use one workspace per thread.
+class AlignmentWorkspace
+{
+public:
+  /// Number of DP cells the matrices can hold without reallocation
+  size_t capacity() const { return f.size(); }
+
+private:
+  friend class Alignment;
+  std::vector<int> f;
+  std::vector<Alignment::Traceback> t;
+  std::vector<Alignment::Wavefront> wavefronts;
+  std::vector<uint8_t> blocked; // cells removed by computeLocalTopK()
+  std::vector<int> rowMax;
+  std::vector<uint32_t> rowArg;
+  std::vector<EditOp> wfaOps; // WFA traceback, stored in [wfaBegin, wfaEnd)
+  size_t wfaBegin = 0;
+  size_t wfaEnd = 0;
+  const Alignment* owner = nullptr;
+};
+
+/// Print an alignment (see Alignment::getAlignment()) as three lines,
+/// split into blocks of @p width columns (0 = a single block)
+void formatAlignment(std::ostream& os, const std::string& a1, const std::string& gaps, const std::string& a2,
+                     const size_t width = 0);
+
+/// Convert CIGAR runs into the usual text form, e.g. "3=1X2I5="
+std::string cigarToString(const std::vector<CigarRun>& cigar);
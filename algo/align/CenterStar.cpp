@@ -0,0 +1,113 @@
+#include "CenterStar.hpp"
+#include "Alignment.hpp"
+
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+
+
+namespace {
+
+/// Run fn(task) for task in [0, tasks) on @p threads threads (dynamic scheduling; each thread gets its own workspace)
+template <typename Fn>
+void parallelFor(const size_t tasks, const unsigned threads, Fn fn) {
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        AlignmentWorkspace ws;
+        for (size_t task = next++; task < tasks; task = next++) fn(task, ws);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (auto& t : pool) t.join();
+}
+
+} // namespace
+
+std::vector<std::string> centerStar(const std::vector<std::string>& seqs, const int match, const int mismatch,
+                                    const int gap, unsigned threads, size_t* center) {
+    if (seqs.empty()) throw(std::invalid_argument("Need at least one sequence!"));
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t n = seqs.size();
+
+    // 1. all-vs-all scores (upper triangle), pair index -> (a, b)
+    std::vector<std::pair<size_t, size_t>> pairs;
+    pairs.reserve(n * (n - 1) / 2);
+    for (size_t a = 0; a < n; a++) {
+        for (size_t b = a + 1; b < n; b++) pairs.emplace_back(a, b);
+    }
+    std::vector<int> scores(pairs.size());
+    parallelFor(pairs.size(), threads, [&](const size_t p, AlignmentWorkspace& ws) {
+        Alignment align(seqs[pairs[p].first], seqs[pairs[p].second], ws);
+        align.computeScore(match, mismatch, gap);
+        scores[p] = align.getScore();
+    });
+
+    std::vector<long long> sums(n, 0);
+    for (size_t p = 0; p < pairs.size(); p++) {
+        sums[pairs[p].first] += scores[p];
+        sums[pairs[p].second] += scores[p];
+    }
+    size_t c = 0;
+    for (size_t i = 1; i < n; i++) {
+        if (sums[i] > sums[c]) c = i;
+    }
+    if (center) *center = c;
+
+    // 2. center vs. each sequence, as edit operations (center = seq_v, so INSERTION = gap in the center)
+    const std::string& cs = seqs[c];
+    std::vector<std::vector<EditOp>> ops(n);
+    parallelFor(n, threads, [&](const size_t i, AlignmentWorkspace& ws) {
+        if (i == c) return;
+        Alignment align(cs, seqs[i], ws);
+        align.compute(match, mismatch, gap);
+        align.getEditOps(ops[i]);
+    });
+
+    // 3. merge: gapsBefore[p] = number of gap columns in front of center position p (p == |center|: at the end)
+    std::vector<size_t> gapsBefore(cs.size() + 1, 0);
+    for (size_t i = 0; i < n; i++) {
+        size_t p = 0;
+        size_t run = 0;
+        for (const EditOp op : ops[i]) {
+            if (op == EditOp::INSERTION) {
+                ++run;
+                continue;
+            }
+            gapsBefore[p] = std::max(gapsBefore[p], run);
+            run = 0;
+            ++p;
+        }
+        gapsBefore[p] = std::max(gapsBefore[p], run);
+    }
+    size_t columns = cs.size();
+    for (const size_t g : gapsBefore) columns += g;
+
+    std::vector<std::string> rows(n);
+    rows[c].reserve(columns);
+    for (size_t p = 0; p <= cs.size(); p++) {
+        rows[c].append(gapsBefore[p], '-');
+        if (p < cs.size()) rows[c] += cs[p];
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (i == c) continue;
+        std::string& row = rows[i];
+        row.reserve(columns);
+        size_t p = 0;    // center position
+        size_t j = 0;    // position in seqs[i]
+        size_t run = 0;  // insertions emitted in front of center position p
+        for (const EditOp op : ops[i]) {
+            if (op == EditOp::INSERTION) {
+                row += seqs[i][j++];
+                ++run;
+                continue;
+            }
+            row.append(gapsBefore[p] - run, '-');
+            run = 0;
+            row += (op == EditOp::DELETION) ? '-' : seqs[i][j++];
+            ++p;
+        }
+        row.append(gapsBefore[p] - run, '-');
+    }
+    return rows;
+}
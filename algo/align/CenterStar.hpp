@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/// Center-star multiple sequence alignment.
+///
+/// 1. All-vs-all score-only global alignments (Alignment::computeScore, linear memory) pick the center:
+///    the sequence with the largest sum of scores to all others.
+/// 2. The center is aligned to every other sequence (full traceback, center = seq_v).
+/// 3. The pairwise alignments are merged into one MSA ("once a gap, always a gap"): a gap column in the center
+///    is inserted as often as the largest number of insertions any sequence has at that position.
+/// Both pairwise stages are spread over @p threads worker threads, each with its own AlignmentWorkspace.
+/// The projection of the MSA onto the center and any sequence i is an optimal pairwise alignment.
+///
+/// @param seqs Sequences to align (at least one)
+/// @param threads Number of worker threads (0 = hardware concurrency)
+/// @param[out] center Index of the chosen center sequence (optional)
+/// @return One row per input sequence (same order), gaps denoted as '-'; all rows have equal length
+/// @throws std::invalid_argument if @p seqs is empty
+std::vector<std::string> centerStar(const std::vector<std::string>& seqs, const int match, const int mismatch,
+                                    const int gap, unsigned threads = 0, size_t* center = nullptr);
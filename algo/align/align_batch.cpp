@@ -0,0 +1,214 @@
+#include "align_batch.hpp"
+#include "Alignment.hpp"
+
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+
+
+FastaReader::FastaReader(std::istream& input) : is(&input) {
+}
+
+bool FastaReader::next(std::string& name, std::string& seq) {
+    seq.clear();
+    std::string line;
+    // find the first header (later headers were already read as lookahead)
+    while (header.empty()) {
+        if (!std::getline(*is, line)) return false;
+        if (!line.empty() && line[0] == '>') header = line;
+    }
+    name = header.substr(1, header.find_first_of(" \t\r") - 1);
+    header.clear();
+    while (std::getline(*is, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty() && line[0] == '>') {
+            header = line;
+            break;
+        }
+        seq += line;
+    }
+    return true;
+}
+
+PairReader::PairReader(std::istream& fasta_v, std::istream& fasta_h) : tsv(nullptr), fasta_v(fasta_v), fasta_h(fasta_h) {
+}
+
+PairReader::PairReader(std::istream& tsv) : tsv(&tsv), fasta_v(tsv), fasta_h(tsv) {
+}
+
+bool PairReader::next(SequencePair& pair) {
+    if (tsv == nullptr) {
+        const bool has_v = fasta_v.next(pair.name, pair.seq_v);
+        const bool has_h = fasta_h.next(ignored, pair.seq_h);
+        if (has_v != has_h) throw(std::runtime_error("FASTA files have different numbers of records!"));
+        return has_v;
+    }
+
+    std::string text;
+    while (std::getline(*tsv, text)) {
+        ++line;
+        if (!text.empty() && text.back() == '\r') text.pop_back();
+        if (text.empty() || text[0] == '#') continue;
+        const size_t tab1 = text.find('\t');
+        if (tab1 == std::string::npos) throw(std::runtime_error("Line " + std::to_string(line) + ": expected at least two columns!"));
+        const size_t tab2 = text.find('\t', tab1 + 1);
+        if (tab2 == std::string::npos) {
+            pair.name = std::to_string(line);
+            pair.seq_v = text.substr(0, tab1);
+            pair.seq_h = text.substr(tab1 + 1);
+        } else {
+            pair.name = text.substr(0, tab1);
+            pair.seq_v = text.substr(tab1 + 1, tab2 - tab1 - 1);
+            pair.seq_h = text.substr(tab2 + 1, text.find('\t', tab2 + 1) - tab2 - 1);
+        }
+        return true;
+    }
+    return false;
+}
+
+namespace {
+
+/// A chunk of consecutive pairs and, once aligned, their output lines
+struct Chunk {
+    uint64_t id;
+    std::vector<SequencePair> pairs;
+    std::string output;
+};
+
+void alignChunk(Chunk& chunk, const BatchOptions& options, AlignmentWorkspace& ws, std::vector<CigarRun>& cigar) {
+    chunk.output.clear();
+    for (const SequencePair& p : chunk.pairs) {
+        Alignment align(p.seq_v, p.seq_h, ws);
+        if (options.wfa) align.computeWFA(options.match, options.mismatch, options.gap);
+        else align.compute(options.match, options.mismatch, options.gap, options.local);
+        align.getCigar(cigar);
+
+        chunk.output += p.name;
+        chunk.output += '\t';
+        chunk.output += std::to_string(align.getScore());
+        if (options.local) {
+            auto [begin_v, begin_h] = align.getAlignmentStart();
+            chunk.output += '\t';
+            chunk.output += std::to_string(begin_v);
+            chunk.output += '\t';
+            chunk.output += std::to_string(begin_h);
+        }
+        chunk.output += '\t';
+        chunk.output += cigarToString(cigar);
+        chunk.output += '\n';
+    }
+}
+
+} // namespace
+
+uint64_t alignBatch(PairReader& reader, const BatchOptions& options, std::ostream& out) {
+    if (options.threads == 0 || options.chunk_size == 0) throw(std::invalid_argument("Need at least one thread and one pair per chunk!"));
+    if (options.wfa && options.local) throw(std::invalid_argument("WFA only supports global alignments!"));
+    if (options.wfa) {
+        // validate the scores once, instead of failing inside a worker
+        Alignment probe("", "");
+        probe.computeWFA(options.match, options.mismatch, options.gap);
+    }
+
+    const size_t max_in_flight = 2 * options.threads;
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Chunk> todo;             // read, waiting for a worker
+    std::map<uint64_t, Chunk> done;     // aligned, waiting to be written in order
+    size_t in_flight = 0;
+    uint64_t chunks_read = 0;
+    bool input_done = false;
+    std::exception_ptr error;
+
+    auto worker = [&]() {
+        AlignmentWorkspace ws;
+        std::vector<CigarRun> cigar;
+        for (;;) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return !todo.empty() || input_done || error; });
+                if (todo.empty() || error) return;
+                chunk = std::move(todo.front());
+                todo.pop_front();
+            }
+            try {
+                alignChunk(chunk, options, ws, cigar);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m);
+                if (!error) error = std::current_exception();
+                cv.notify_all();
+                return;
+            }
+            std::lock_guard<std::mutex> lock(m);
+            const uint64_t id = chunk.id;
+            done.emplace(id, std::move(chunk));
+            cv.notify_all();
+        }
+    };
+
+    auto writer = [&]() {
+        uint64_t next = 0;
+        for (;;) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return done.count(next) || (input_done && next == chunks_read) || error; });
+                if (error || !done.count(next)) return;
+                chunk = std::move(done[next]);
+                done.erase(next);
+            }
+            out << chunk.output; // write outside the lock
+            std::lock_guard<std::mutex> lock(m);
+            --in_flight;
+            ++next;
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < options.threads; ++t) pool.emplace_back(worker);
+    std::thread output(writer);
+
+    // the calling thread reads; it blocks while too many chunks are in flight
+    uint64_t pairs = 0;
+    try {
+        for (;;) {
+            Chunk chunk;
+            chunk.pairs.resize(options.chunk_size);
+            size_t n = 0;
+            while (n < options.chunk_size && reader.next(chunk.pairs[n])) ++n;
+            if (n == 0) break;
+            chunk.pairs.resize(n);
+            pairs += n;
+
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return in_flight < max_in_flight || error; });
+            if (error) break;
+            chunk.id = chunks_read++;
+            ++in_flight;
+            todo.push_back(std::move(chunk));
+            cv.notify_all();
+            if (n < options.chunk_size) break;
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m);
+        if (!error) error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m);
+        input_done = true;
+        cv.notify_all();
+    }
+
+    for (auto& t : pool) t.join();
+    output.join();
+    if (error) std::rethrow_exception(error);
+    out.flush();
+    return pairs;
+}
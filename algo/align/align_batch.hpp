@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+/// One input pair of a batch run
+struct SequencePair {
+  std::string name;
+  std::string seq_v;
+  std::string seq_h;
+};
+
+/// Streams the records of a FASTA file one at a time (multi-line records are joined).
+/// The stream must outlive the reader.
+class FastaReader
+{
+public:
+  explicit FastaReader(std::istream& input);
+
+  /// Read the next record; @p name is the header up to the first whitespace.
+  /// Returns false at the end of the input.
+  bool next(std::string& name, std::string& seq);
+
+private:
+  std::istream* is;
+  std::string header; // lookahead: header of the next record
+};
+
+/// Streams sequence pairs one at a time, i.e. never holds more than the current pair in memory.
+/// Input is either two FASTA streams (the i-th record of the first is paired with the i-th record of the second,
+/// named after the first) or one TSV stream with lines 'name<TAB>seq1<TAB>seq2' or 'seq1<TAB>seq2'
+/// (named by line number). The streams must outlive the reader.
+class PairReader
+{
+public:
+  /// Read pairs from two FASTA streams
+  PairReader(std::istream& fasta_v, std::istream& fasta_h);
+
+  /// Read pairs from a TSV stream
+  explicit PairReader(std::istream& tsv);
+
+  /// Read the next pair into @p pair; returns false at the end of the input.
+  /// @throws std::runtime_error if the input is malformed (e.g. the FASTA files differ in their number of records)
+  bool next(SequencePair& pair);
+
+private:
+  std::istream* tsv; // nullptr for FASTA input
+  FastaReader fasta_v;
+  FastaReader fasta_h;
+  std::string ignored;
+  uint64_t line = 0;
+};
+
+/// Parameters of a batch run
+struct BatchOptions {
+  int match = 1;
+  int mismatch = -1;
+  int gap = -2;
+  bool local = false;        ///< Smith-Waterman instead of global alignment
+  bool wfa = false;          ///< global alignment with the wavefront algorithm
+  unsigned threads = 1;      ///< number of worker threads
+  size_t chunk_size = 1024;  ///< pairs per work item
+};
+
+/// Align all pairs from @p reader on a pool of worker threads and write one line per pair to @p out, in input order:
+///   global: name<TAB>score<TAB>cigar
+///   local:  name<TAB>score<TAB>begin_v<TAB>begin_h<TAB>cigar
+/// Pairs are handed out in chunks; at most 2*threads chunks are in flight (read, aligned or waiting to be written),
+/// so memory stays bounded for arbitrarily large inputs. Every worker reuses one AlignmentWorkspace.
+/// @return number of aligned pairs
+/// @throws std::invalid_argument for invalid options, or whatever reading or aligning threw
+uint64_t alignBatch(PairReader& reader, const BatchOptions& options, std::ostream& out);
@@ -0,0 +1,243 @@
+// compile with
+// make align_bench
+//
+// Times every Alignment engine over sequence pairs of several lengths and identities and reports
+// GCUPS (giga cell updates per second, counted as |seq1|*|seq2| cells for every engine),
+// latency percentiles and the peak resident memory of each run.
+//
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <sys/resource.h>
+
+#include "Alignment.hpp"
+
+using namespace std;
+
+struct Engine
+{
+  string name;
+  bool quadratic; // O(n*m) time, skipped for pairs above --max-cells
+  function<int(Alignment&, AlignmentWorkspace&, const string&, const string&)> run;
+};
+
+static const int MATCH = 2, MISMATCH = -3, GAP = -4;
+
+/// Reset the peak RSS counter (Linux only; otherwise the peak is process-wide)
+static void resetPeakRSS()
+{
+  ofstream clear("/proc/self/clear_refs");
+  if (clear.good()) clear << "5";
+}
+
+/// Peak resident set size in MB since the last resetPeakRSS()
+static double peakRSS()
+{
+  ifstream status("/proc/self/status");
+  string line;
+  while (getline(status, line))
+  {
+    if (line.rfind("VmHWM:", 0) == 0) return stod(line.substr(6)) / 1024.0;
+  }
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+static string randomDNA(size_t len, mt19937& rng)
+{
+  string s(len, 'A');
+  for (auto& c : s) c = "ACGT"[rng() % 4];
+  return s;
+}
+
+/// Copy of @p s where each position is edited with probability 1-identity (60% substitutions, 20% insertions, 20% deletions)
+static string mutate(const string& s, double identity, mt19937& rng)
+{
+  uniform_real_distribution<double> coin(0.0, 1.0);
+  string out;
+  out.reserve(s.size() + s.size() / 8);
+  for (char c : s)
+  {
+    if (coin(rng) >= 1.0 - identity)
+    {
+      out += c;
+      continue;
+    }
+    double kind = coin(rng);
+    if (kind < 0.6) out += "ACGT"[(string("ACGT").find(c) + 1 + rng() % 3) % 4];
+    else if (kind < 0.8) { out += c; out += "ACGT"[rng() % 4]; }
+    // else: deletion
+  }
+  return out;
+}
+
+/// Pairs of consecutive FASTA records
+static vector<pair<string, string>> loadPairs(const string& filename)
+{
+  ifstream is(filename);
+  if (!is.good()) throw runtime_error("Cannot open file '" + filename + "'");
+  vector<string> records;
+  string line;
+  while (getline(is, line))
+  {
+    if (line.empty()) continue;
+    if (line[0] == '>') records.emplace_back();
+    else if (!records.empty()) records.back() += line;
+  }
+  vector<pair<string, string>> pairs;
+  for (size_t i = 0; i + 1 < records.size(); i += 2) pairs.emplace_back(records[i], records[i+1]);
+  return pairs;
+}
+
+static double percentile(vector<double> v, double p)
+{
+  if (v.empty()) return 0;
+  sort(v.begin(), v.end());
+  return v[min(v.size() - 1, size_t(p * (v.size() - 1) + 0.5))];
+}
+
+/// Time one engine on all pairs of a regime; returns false if a score disagrees with @p reference
+static bool benchEngine(const Engine& engine, const string& regime, const vector<pair<string, string>>& pairs,
+                        vector<int>& reference, double max_cells)
+{
+  double cells = 0;
+  size_t longest = 0;
+  for (const auto& p : pairs)
+  {
+    cells += double(p.first.size()) * p.second.size();
+    longest = max(longest, max(p.first.size(), p.second.size()));
+  }
+  if (engine.quadratic && double(longest) * longest > max_cells)
+  {
+    cout << left << setw(22) << regime << setw(12) << engine.name << "skipped (matrix > " << max_cells << " cells)\n";
+    return true;
+  }
+
+  resetPeakRSS();
+  AlignmentWorkspace ws;
+  vector<double> latency;
+  latency.reserve(pairs.size());
+  bool agree = true;
+  double total = 0;
+  for (size_t i = 0; i < pairs.size(); ++i)
+  {
+    Alignment align(pairs[i].first, pairs[i].second, ws);
+    auto begin = chrono::steady_clock::now();
+    int score = engine.run(align, ws, pairs[i].first, pairs[i].second);
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    latency.push_back(sec * 1e3);
+    total += sec;
+    if (reference.size() <= i) reference.push_back(score);
+    else if (reference[i] != score) agree = false;
+  }
+
+  cout << left << setw(22) << regime << setw(12) << engine.name << right << fixed
+       << setw(8) << pairs.size()
+       << setw(10) << setprecision(3) << (total > 0 ? cells / total / 1e9 : 0.0)
+       << setw(12) << setprecision(3) << percentile(latency, 0.5)
+       << setw(12) << percentile(latency, 0.9)
+       << setw(12) << percentile(latency, 0.99)
+       << setw(10) << setprecision(1) << peakRSS()
+       << (agree ? "" : "  SCORE MISMATCH") << "\n";
+  return agree;
+}
+
+int main(int argc, const char* argv[])
+{
+  vector<size_t> lengths = {100, 1000, 10000, 100000};
+  vector<double> identities = {0.99, 0.95, 0.80};
+  double max_cells = 2.5e8;
+  double cell_budget = 2e8; // DP cells per regime, determines the number of pairs
+  string fasta;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    string arg = argv[i];
+    if (arg == "--fasta" && i + 1 < argc) fasta = argv[++i];
+    else if (arg == "--max-cells" && i + 1 < argc) max_cells = atof(argv[++i]);
+    else if (arg == "--budget" && i + 1 < argc) cell_budget = atof(argv[++i]);
+    else if (arg == "--lengths" && i + 1 < argc)
+    {
+      lengths.clear();
+      stringstream ss(argv[++i]);
+      for (string tok; getline(ss, tok, ',');) lengths.push_back(stoul(tok));
+    }
+    else
+    {
+      cerr << "Usage: " << argv[0] << " [--lengths 100,1000,...] [--max-cells C] [--budget CELLS] [--fasta <pairs.fasta>]\n"
+           << "  --lengths    sequence lengths of the generated pairs (default 100,1000,10000,100000)\n"
+           << "  --max-cells  largest DP matrix to attempt (default 2.5e8); bigger ones are skipped for the O(n*m) engines\n"
+           << "  --budget     DP cells per length/identity regime, i.e. the number of pairs (default 2e8)\n"
+           << "  --fasta      benchmark consecutive records of this file as pairs instead\n";
+      return 1;
+    }
+  }
+
+  vector<Engine> engines = {
+    {"dp", true, [](Alignment& a, AlignmentWorkspace&, const string&, const string&) {
+       a.compute(MATCH, MISMATCH, GAP); return a.getScore(); }},
+    {"dp-cigar", true, [](Alignment& a, AlignmentWorkspace&, const string&, const string&) {
+       static vector<CigarRun> cigar;
+       a.compute(MATCH, MISMATCH, GAP); a.getCigar(cigar); return a.getScore(); }},
+    {"dp-score", true, [](Alignment& a, AlignmentWorkspace&, const string&, const string&) {
+       a.computeScore(MATCH, MISMATCH, GAP); return a.getScore(); }},
+    {"dp-private", true, [](Alignment&, AlignmentWorkspace&, const string& v, const string& h) {
+       Alignment own(v, h); // fresh workspace every time, i.e. the allocation cost
+       own.compute(MATCH, MISMATCH, GAP); return own.getScore(); }},
+    {"wfa", false, [](Alignment& a, AlignmentWorkspace&, const string&, const string&) {
+       static vector<CigarRun> cigar;
+       a.computeWFA(MATCH, MISMATCH, GAP); a.getCigar(cigar); return a.getScore(); }},
+    {"wfa-score", false, [](Alignment& a, AlignmentWorkspace&, const string&, const string&) {
+       a.computeWFA(MATCH, MISMATCH, GAP, true); return a.getScore(); }},
+  };
+
+  vector<pair<string, vector<pair<string, string>>>> regimes;
+  if (!fasta.empty())
+  {
+    regimes.emplace_back(fasta, loadPairs(fasta));
+  }
+  else
+  {
+    mt19937 rng(1234);
+    for (size_t len : lengths)
+    {
+      size_t count = max<size_t>(1, min<size_t>(1000, size_t(cell_budget / (double(len) * len))));
+      for (double identity : identities)
+      {
+        vector<pair<string, string>> pairs;
+        for (size_t i = 0; i < count; ++i)
+        {
+          string s = randomDNA(len, rng);
+          pairs.emplace_back(s, mutate(s, identity, rng));
+        }
+        ostringstream name;
+        name << len << "bp@" << identity * 100 << "%";
+        regimes.emplace_back(name.str(), move(pairs));
+      }
+    }
+  }
+
+  cout << left << setw(22) << "regime" << setw(12) << "engine" << right
+       << setw(8) << "pairs" << setw(10) << "GCUPS" << setw(12) << "p50[ms]" << setw(12) << "p90[ms]"
+       << setw(12) << "p99[ms]" << setw(10) << "RSS[MB]" << "\n";
+  bool ok = true;
+  for (const auto& regime : regimes)
+  {
+    vector<int> reference;
+    for (const auto& engine : engines)
+    {
+      ok &= benchEngine(engine, regime.first, regime.second, reference, max_cells);
+    }
+  }
+  if (!ok) std::cerr << "\nEngines disagree on some scores -- go fix your code!\n";
+  return ok ? 0 : 1;
+}
@@ -1,9 +1,61 @@
 #include <iostream>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
 #include "Alignment.hpp"
+#include "align_batch.hpp"
+
+// Batch mode: align_main --batch (<pairs.tsv> | <seqs1.fasta> <seqs2.fasta>) <match> <mismatch> <gap> [--local] [--wfa] [--threads N]
+int batchMain(int argc, char* argv[]) {
+    std::vector<std::string> args;
+    BatchOptions options;
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--local") options.local = true;
+        else if (arg == "--wfa") options.wfa = true;
+        else if (arg == "--threads" && i + 1 < argc) options.threads = std::stoi(argv[++i]);
+        else args.push_back(arg);
+    }
+    if (args.size() != 4 && args.size() != 5) {
+        std::cerr << "Usage: " << argv[0] << " --batch (<pairs.tsv> | <seqs1.fasta> <seqs2.fasta>) <match_score> <mismatch_penalty> <gap_penalty>"
+                  << " [--local] [--wfa] [--threads N]\n";
+        return 1;
+    }
+    const size_t files = args.size() - 3;
+    options.match = std::stoi(args[files]);
+    options.mismatch = std::stoi(args[files + 1]);
+    options.gap = std::stoi(args[files + 2]);
+
+    std::ifstream first(args[0]);
+    std::ifstream second;
+    if (files == 2) second.open(args[1]);
+    if (!first.good() || (files == 2 && !second.good())) {
+        std::cerr << "Error: cannot open input file(s)\n";
+        return 1;
+    }
+
+    try {
+        std::unique_ptr<PairReader> reader = (files == 2) ? std::make_unique<PairReader>(first, second)
+                                                          : std::make_unique<PairReader>(first);
+        std::ios::sync_with_stdio(false);
+        const uint64_t pairs = alignBatch(*reader, options, std::cout);
+        std::cerr << "aligned " << pairs << " pairs\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--batch") return batchMain(argc, argv);
+
     if (argc != 6 && argc != 7) {
-        std::cerr << "Usage: " << argv[0] << " <sequence1> <sequence2> <match_score> <mismatch_penalty> <gap_penalty>\n";
+        std::cerr << "Usage: " << argv[0] << " <sequence1> <sequence2> <match_score> <mismatch_penalty> <gap_penalty>\n"
+                  << "       " << argv[0] << " --batch (<pairs.tsv> | <seqs1.fasta> <seqs2.fasta>) <match_score> <mismatch_penalty> <gap_penalty>"
+                  << " [--local] [--wfa] [--threads N]\n";
         return 1;
     }
 
@@ -27,12 +79,13 @@ int main(int argc, char* argv[]) {
 
         std::string a1, gaps, a2;
         alignment.getAlignment(a1, gaps, a2);
+        std::vector<CigarRun> cigar;
+        alignment.getCigar(cigar);
         int score = alignment.getScore();
 
-        std::cout << a1 << "\n";
-        std::cout << gaps << "\n";
-        std::cout << a2 << "\n";
-        std::cout << "score:" << score << std::endl;
+        formatAlignment(std::cout, a1, gaps, a2);
+        std::cout << "score:" << score << "\n";
+        std::cout << "cigar:" << cigarToString(cigar) << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
@@ -1,7 +1,12 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
 #include "Alignment.hpp"
+#include "align_batch.hpp"
+#include "CenterStar.hpp"
 
 using namespace std;
 
@@ -203,6 +208,278 @@ int test_Smith()
   return points;
 }
 
+// recompute the score of a printed alignment; also checks that it spells out both sequences
+static int rescore(const string& a1, const string& a2, const string& seq_v, const string& seq_h,
+                   int match, int mismatch, int gap)
+{
+  string v, h;
+  int score = 0;
+  for (size_t i = 0; i < a1.size(); ++i)
+  {
+    if (a1[i] != '-') v += a1[i];
+    if (a2[i] != '-') h += a2[i];
+    if (a1[i] == '-' || a2[i] == '-') score += gap;
+    else score += (a1[i] == a2[i]) ? match : mismatch;
+  }
+  if (v != seq_v || h != seq_h || a1.size() != a2.size()) return std::numeric_limits<int>::min();
+  return score;
+}
+
+static string mutate(string s, int edits, unsigned seed)
+{
+  srand(seed);
+  for (int e = 0; e < edits && !s.empty(); ++e)
+  {
+    size_t pos = rand() % s.size();
+    switch (rand() % 3)
+    {
+      case 0: s[pos] = "ACGT"[rand() % 4]; break;
+      case 1: s.erase(pos, 1); break;
+      default: s.insert(pos, 1, "ACGT"[rand() % 4]);
+    }
+  }
+  return s;
+}
+
+bool test_wfa()
+{
+  // WFA must agree with the DP on the score and produce a valid optimal alignment
+  vector<pair<string, string>> pairs = {
+    {"IMISSMISSISSIPPI", "MYMISSISAHIPPIE"}, {"PEPTIDE", "EANANA"}, {"LEFT", "XXXLEFT"}, {"", ""}, {"A", ""}};
+  srand(42);
+  string base(300, 'A');
+  for (auto& c : base) c = "ACGT"[rand() % 4];
+  for (unsigned seed = 0; seed < 5; ++seed) pairs.emplace_back(base, mutate(base, seed * 3, seed));
+
+  vector<vector<int>> params = {{3, -4, -6}, {3, -4, -1}, {1, -1, -2}, {2, -3, -5}};
+  for (const auto& p : pairs)
+  {
+    for (const auto& sc : params)
+    {
+      Alignment dp(p.first, p.second);
+      dp.compute(sc[0], sc[1], sc[2]);
+      Alignment wfa(p.first, p.second);
+      wfa.computeWFA(sc[0], sc[1], sc[2]);
+      Alignment light(p.first, p.second);
+      light.computeWFA(sc[0], sc[1], sc[2], true);
+      string s1, g, s2;
+      wfa.getAlignment(s1, g, s2);
+      if (wfa.getScore() != dp.getScore() || light.getScore() != dp.getScore() ||
+          rescore(s1, s2, p.first, p.second, sc[0], sc[1], sc[2]) != dp.getScore())
+      {
+        std::cerr << "WFA mismatch for " << p.first << " / " << p.second << ": " << wfa.getScore()
+                  << " vs. " << dp.getScore() << "\n";
+        return false;
+      }
+    }
+  }
+
+  int caught = 0;
+  Alignment bad("ACGT", "ACGA");
+  try { bad.computeWFA(1, 1, -1); } catch (std::invalid_argument&) { ++caught; }
+  Alignment light("ACGT", "ACGA");
+  light.computeWFA(1, -1, -1, true);
+  try { string s1, g, s2; light.getAlignment(s1, g, s2); } catch (std::runtime_error&) { ++caught; }
+  return caught == 2;
+}
+
+bool test_workspace()
+{
+  // one workspace for many pairs: same results as the owning Alignment, and no regrowth for smaller pairs
+  AlignmentWorkspace ws;
+  vector<pair<string, string>> pairs = {
+    {"IMISSMISSISSIPPI", "MYMISSISAHIPPIE"}, {"PEPTIDE", "EANANA"}, {"LEFT", "XXXLEFT"}, {"", ""}};
+  size_t cap = 0;
+  for (int round = 0; round < 2; ++round)
+  {
+    for (const auto& p : pairs)
+    {
+      Alignment own(p.first, p.second);
+      own.compute(3, -4, -1, round == 1);
+      Alignment shared(std::string_view(p.first), std::string_view(p.second), ws);
+      shared.compute(3, -4, -1, round == 1);
+      string s1, g1, t1, s2, g2, t2;
+      own.getAlignment(s1, g1, t1);
+      shared.getAlignment(s2, g2, t2);
+      if (own.getScore() != shared.getScore() || s1 != s2 || g1 != g2 || t1 != t2) return false;
+      if (round == 0)
+      { // wavefronts live in the same workspace
+        shared.computeWFA(3, -4, -1);
+        if (shared.getScore() != own.getScore()) return false;
+      }
+    }
+    if (round == 0) cap = ws.capacity();
+    else if (ws.capacity() != cap) return false;
+  }
+
+  // a second alignment on the same workspace invalidates the first traceback
+  Alignment a("ACGT", "ACGT", ws);
+  a.compute(1, -1, -1);
+  Alignment b("TTTT", "ACGT", ws);
+  b.compute(1, -1, -1);
+  try
+  {
+    string s1, g, s2;
+    a.getAlignment(s1, g, s2);
+  }
+  catch (std::runtime_error&)
+  {
+    return a.getScore() == 4;
+  }
+  return false;
+}
+
+bool test_cigar()
+{
+  Alignment align("PEPTIDE", "EANANA");
+  align.compute(3, -4, -1);
+  // PE-----PTIDE
+  // -EANANA-----
+  std::vector<CigarRun> cigar;
+  align.getCigar(cigar);
+  std::vector<EditOp> ops;
+  align.getEditOps(ops);
+  if (cigarToString(cigar) != "1D1=5I5D" || ops.size() != 12 || ops[1] != EditOp::MATCH) return false;
+
+  // local alignments start inside the sequences
+  Alignment local("XXXIMISSMISSISSIPPIXXX", "YYYMYMISSISAHIPPIEYYY");
+  local.compute(3, -4, -1, true);
+  local.getCigar(cigar);
+  auto start = local.getAlignmentStart();
+  if (cigarToString(cigar) != "6=2I1D4=" || start.first != 8 || start.second != 5) return false;
+
+  // WFA fills the same kind of buffer; a reused buffer keeps its memory
+  Alignment wfa("IMISSMISSISSIPPI", "MYMISSISAHIPPIE");
+  wfa.computeWFA(3, -4, -1);
+  ops.reserve(64);
+  const EditOp* before = ops.data();
+  wfa.getEditOps(ops);
+  string s1, g, s2;
+  wfa.getAlignment(s1, g, s2);
+  return ops.data() == before && ops.size() == s1.size();
+}
+
+bool test_topk()
+{
+  // two copies of a domain: both are reported, the best one first, without sharing any aligned pair
+  string genome = "TTTTTTGATTACAGATTACATTTTTTTTGATTACAGATTCCATTTTTT";
+  string domain = "GATTACAGATTACA";
+  Alignment align(genome, domain);
+  std::vector<LocalHit> hits;
+  align.computeLocalTopK(2, -3, -4, 5, hits);
+  if (hits.size() < 2 || hits[0].score != 28 || hits[1].score != 23 || align.getScore() != 28) return false;
+  if (hits[0].beginV != 6 || hits[0].endV != 20 || hits[1].beginV != 28 || hits[1].endV != 42) return false;
+  if (cigarToString(hits[0].cigar) != "14=" || cigarToString(hits[1].cigar) != "11=1X2=") return false;
+  for (size_t h = 1; h < hits.size(); ++h)
+  {
+    if (hits[h].score > hits[h-1].score) return false;
+  }
+
+  // the first hit is the plain Smith-Waterman alignment
+  Alignment sw(genome, domain);
+  sw.compute(2, -3, -4, true);
+  std::vector<CigarRun> cigar;
+  sw.getCigar(cigar);
+  if (cigarToString(cigar) != cigarToString(hits[0].cigar)) return false;
+
+  // nothing positive left: stop early
+  Alignment none("AAAA", "CCCC");
+  none.computeLocalTopK(2, -3, -4, 3, hits);
+  return hits.empty() && none.getScore() == 0;
+}
+
+bool test_batch()
+{
+  // many small chunks on several threads: output must still be in input order and match single alignments
+  std::ostringstream tsv, expected;
+  srand(3);
+  for (int i = 0; i < 200; ++i)
+  {
+    string a(5 + rand() % 40, 'A'), b(5 + rand() % 40, 'A');
+    for (auto& c : a) c = "ACGT"[rand() % 4];
+    for (auto& c : b) c = "ACGT"[rand() % 4];
+    tsv << "pair" << i << "\t" << a << "\t" << b << "\n";
+    Alignment align(a, b);
+    align.compute(2, -3, -4);
+    std::vector<CigarRun> cigar;
+    align.getCigar(cigar);
+    expected << "pair" << i << "\t" << align.getScore() << "\t" << cigarToString(cigar) << "\n";
+  }
+  std::istringstream in(tsv.str());
+  PairReader reader(in);
+  BatchOptions options;
+  options.match = 2;
+  options.mismatch = -3;
+  options.gap = -4;
+  options.threads = 4;
+  options.chunk_size = 7;
+  std::ostringstream out;
+  if (alignBatch(reader, options, out) != 200 || out.str() != expected.str()) return false;
+
+  // two FASTA inputs (multi-line records), named after the first file
+  std::istringstream fa1(">x first\nACGT\nACGT\n>y\nGATTACA\n"), fa2(">p\nACGTACGT\n>q\nGATACA\n");
+  PairReader fasta(fa1, fa2);
+  options.wfa = true;
+  std::ostringstream out2;
+  alignBatch(fasta, options, out2);
+  if (out2.str() != "x\t16\t8=\ny\t8\t3=1D3=\n") return false;
+
+  // unequal record counts are an error
+  std::istringstream fa3(">x\nACGT\n"), fa4("");
+  PairReader broken(fa3, fa4);
+  std::ostringstream out3;
+  try { alignBatch(broken, options, out3); } catch (std::runtime_error&) { return true; }
+  return false;
+}
+
+bool test_score_only()
+{
+  vector<pair<string, string>> pairs = {
+    {"IMISSMISSISSIPPI", "MYMISSISAHIPPIE"}, {"PEPTIDE", "EANANA"}, {"LEFT", "XXXLEFT"}, {"", ""}, {"", "ACGT"},
+    {"XXXIMISSMISSISSIPPIXXX", "YYYMYMISSISAHIPPIEYYY"}};
+  AlignmentWorkspace ws;
+  for (const auto& p : pairs)
+  {
+    for (bool local : {false, true})
+    {
+      Alignment full(p.first, p.second);
+      full.compute(3, -4, -1, local);
+      Alignment light(p.first, p.second, ws);
+      light.computeScore(3, -4, -1, local);
+      if (full.getScore() != light.getScore()) return false;
+    }
+  }
+  return true;
+}
+
+bool test_center_star()
+{
+  vector<string> seqs = {"GATTACAGATTACA", "GATTACGATTACA", "GATTACAGATTTACA", "GCTTACAGATTACA", "ATTACAGATTAC"};
+  size_t center = 99;
+  vector<string> rows = centerStar(seqs, 2, -3, -4, 3, &center);
+  if (center != 0 || rows.size() != seqs.size()) return false;
+  for (size_t i = 0; i < rows.size(); ++i)
+  {
+    if (rows[i].size() != rows[0].size()) return false;
+    string plain;
+    for (char c : rows[i]) if (c != '-') plain += c;
+    if (plain != seqs[i]) return false;
+
+    // projection onto (center, i) is an optimal pairwise alignment
+    string a1, a2;
+    for (size_t col = 0; col < rows[i].size(); ++col)
+    {
+      if (rows[center][col] == '-' && rows[i][col] == '-') continue;
+      a1 += rows[center][col];
+      a2 += rows[i][col];
+    }
+    Alignment pairwise(seqs[center], seqs[i]);
+    pairwise.compute(2, -3, -4);
+    if (rescore(a1, a2, seqs[center], seqs[i], 2, -3, -4) != pairwise.getScore()) return false;
+  }
+  return centerStar({"ACGT"}, 1, -1, -1) == vector<string>{"ACGT"};
+}
+
 
 int main()
 {
@@ -228,12 +505,40 @@ int main()
     else std::cerr << "      o test_uninitialized failed (-1)!\n";
     std::cout << "current points: " << points << "\n";
 
+    if (test_wfa()) points += 1;
+    else std::cerr << "      o test_wfa failed (-1)!\n";
+    std::cout << "current points: " << points << "\n";
+
+    if (test_workspace()) points += 1;
+    else std::cerr << "      o test_workspace failed (-1)!\n";
+    std::cout << "current points: " << points << "\n";
+
+    if (test_cigar()) points += 1;
+    else std::cerr << "      o test_cigar failed (-1)!\n";
+    std::cout << "current points: " << points << "\n";
+
+    if (test_topk()) points += 1;
+    else std::cerr << "      o test_topk failed (-1)!\n";
+    std::cout << "current points: " << points << "\n";
+
+    if (test_batch()) points += 1;
+    else std::cerr << "      o test_batch failed (-1)!\n";
+    std::cout << "current points: " << points << "\n";
+
+    if (test_score_only()) points += 1;
+    else std::cerr << "      o test_score_only failed (-1)!\n";
+    std::cout << "current points: " << points << "\n";
+
+    if (test_center_star()) points += 1;
+    else std::cerr << "      o test_center_star failed (-1)!\n";
+    std::cout << "current points: " << points << "\n";
+
     // additional points
     int p = test_Smith(); //4 max
     std::cout << "      o test_Smith extra points: " << p << "!\n";
     points += p;
 
-    std::cout << "Final score: " << points << " of 10.\n";
+    std::cout << "Final score: " << points << " of 17.\n";
     
     // returning the points as error code for easier evaluation
     return 100 + points;
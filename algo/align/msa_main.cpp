@@ -0,0 +1,42 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "CenterStar.hpp"
+#include "align_batch.hpp"
+
+int main(int argc, char* argv[]) {
+    if (argc != 5 && !(argc == 7 && std::string(argv[5]) == "--threads")) {
+        std::cerr << "Usage: " << argv[0] << " <sequences.fasta> <match_score> <mismatch_penalty> <gap_penalty> [--threads N]\n";
+        return 1;
+    }
+
+    std::ifstream is(argv[1]);
+    if (!is.good()) {
+        std::cerr << "Error: cannot open '" << argv[1] << "'\n";
+        return 1;
+    }
+
+    try {
+        FastaReader reader(is);
+        std::vector<std::string> names, seqs;
+        std::string name, seq;
+        while (reader.next(name, seq)) {
+            names.push_back(name);
+            seqs.push_back(seq);
+        }
+        unsigned threads = (argc == 7) ? std::stoi(argv[6]) : 0;
+
+        size_t center = 0;
+        std::vector<std::string> rows = centerStar(seqs, std::stoi(argv[2]), std::stoi(argv[3]), std::stoi(argv[4]), threads, &center);
+        std::cerr << "center: " << names[center] << "\n";
+        for (size_t i = 0; i < rows.size(); i++) {
+            std::cout << ">" << names[i] << "\n" << rows[i] << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}